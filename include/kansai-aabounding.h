@@ -17,6 +17,10 @@
 	#define KA_EXPORT // Whitespace
 #endif
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include "japan-matrix.h"
 #include "japan-vector.h"
 
 struct kaAABBox
@@ -43,6 +47,17 @@ struct kaCircle
 	float radius;
 };
 
+struct kaPlane
+{
+	struct jaVectorF3 normal; // Normalized, pointing inside
+	float d;
+};
+
+struct kaFrustum
+{
+	struct kaPlane plane[6]; // Left, right, bottom, top, near, far
+};
+
 KA_EXPORT bool kaAABCollisionRectRect(struct kaAABRectangle a, struct kaAABRectangle b);
 KA_EXPORT bool kaAABCollisionRectCircle(struct kaAABRectangle, struct kaCircle);
 
@@ -55,6 +70,15 @@ KA_EXPORT struct kaAABBox kaAABToBox(struct kaAABRectangle, float min_z, float m
 KA_EXPORT struct jaVectorF2 kaAABMiddleRect(struct kaAABRectangle);
 KA_EXPORT struct jaVectorF3 kaAABMiddleBox(struct kaAABBox);
 
+KA_EXPORT struct kaFrustum kaFrustumFromMatrix(struct jaMatrixF4 m); // Planes in the space where 'm' is applied
+KA_EXPORT bool kaFrustumTestBox(const struct kaFrustum*, struct kaAABBox);
+KA_EXPORT bool kaFrustumTestSphere(const struct kaFrustum*, struct kaSphere);
+
+// Bit 'i % 32' of 'out[i / 32]' set if 'i' is visible, 'out' of '(length + 31) / 32' elements
+KA_EXPORT void kaFrustumCullBoxes(const struct kaFrustum*, const struct kaAABBox* boxes, size_t length, uint32_t* out);
+KA_EXPORT void kaFrustumCullSpheres(const struct kaFrustum*, const struct kaSphere* spheres, size_t length,
+                                    uint32_t* out);
+
 #if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
 
 #define kaAABCollision(a, b)\
@@ -23,12 +23,16 @@
 #include "japan-matrix.h"
 #include "japan-status.h"
 #include "japan-vector.h"
+#include "kansai-aabounding.h"
 #include "kansai-color.h"
 
 #define JA_WIP
 #include "japan-configuration.h"
 
 struct kaWindow;
+struct kaOcclusion;
+struct kaTextureLoad;
+struct kaResidency;
 
 enum kaKey // A subset of 'SDL_scancode.h'
 {
@@ -153,6 +157,27 @@ struct kaEvents
 struct kaProgram
 {
 	unsigned int glptr;
+
+	struct
+	{
+		int world;
+		int local;
+		int camera;
+		int camera_position;
+		int mvp; // If declared, 'world * camera * local' composed in the cpu
+
+		int dequantize_scale;  // If declared, quantized vertices are scaled in the shader,
+		int dequantize_offset; // otherwise in local (not possible with instancing)
+	} uniform;                 // Locations, queried once at link time
+
+	struct
+	{
+		uint32_t world;
+		uint32_t local;
+		uint32_t camera;
+		uint32_t mvp;
+		uint32_t dequantize;
+	} uploaded; // Versions of window values, a cache mutable even through const pointers
 };
 
 struct kaVertex
@@ -162,16 +187,123 @@ struct kaVertex
 	struct jaVectorF2 uv;
 };
 
+struct kaVertexCompact // 20 bytes
+{
+	struct jaVectorF3 position;
+	uint8_t color[4]; // Normalized
+	uint16_t uv[2];   // "
+};
+
+struct kaVertexQuantized // 16 bytes
+{
+	int16_t position[4]; // Normalized, last one as padding
+	uint8_t color[4];
+	uint16_t uv[2];
+};
+
+enum kaVertexFormat
+{
+	KA_VERTEX_FLOAT, // 'kaVertex'
+	KA_VERTEX_COMPACT,
+	KA_VERTEX_QUANTIZED,
+	KA_VERTEX_LAYOUT // Anything, described by a 'kaVertexLayout'
+};
+
+#define KA_MAX_LAYOUT_ATTRIBUTES 5
+#define KA_MAX_LAYOUT_SLOTS 4
+
+enum kaAttributeType
+{
+	KA_ATTRIBUTE_FLOAT,
+	KA_ATTRIBUTE_BYTE,
+	KA_ATTRIBUTE_UNSIGNED_BYTE,
+	KA_ATTRIBUTE_SHORT,
+	KA_ATTRIBUTE_UNSIGNED_SHORT
+};
+
+struct kaAttribute
+{
+	const char* name; // As in the vertex shader
+	int components;   // From 1 to 4
+	enum kaAttributeType type;
+	bool normalized;
+	size_t offset; // In bytes
+	size_t stride; // "
+	int slot;      // Buffer that provides it
+};
+
+struct kaVertexLayout
+{
+	struct kaAttribute attribute[KA_MAX_LAYOUT_ATTRIBUTES]; // Locations in same order, from zero
+	size_t length;
+	int slots; // Buffers required
+
+	unsigned int gl_type[KA_MAX_LAYOUT_ATTRIBUTES];
+	uint32_t mask; // Of locations
+};
+
+enum kaUsage
+{
+	KA_USAGE_STATIC,  // Specified once
+	KA_USAGE_DYNAMIC, // Updated from time to time
+	KA_USAGE_STREAM   // Updated every frame
+};
+
 struct kaVertices
 {
 	unsigned int glptr;
-	uint16_t length; // In elements
+	size_t length; // In elements
+	size_t stride; // Size of an element
+	enum kaVertexFormat format;
+	enum kaUsage usage;
+
+	struct jaVectorF3 scale; // Dequantization, positions are 'offset + scale * position'
+	struct jaVectorF3 offset;
+};
+
+enum kaIndexFormat
+{
+	KA_INDEX_16,
+	KA_INDEX_32 // Requires kaIndexInit32()
 };
 
 struct kaIndex
 {
 	unsigned int glptr;
 	size_t length; // In elements
+	enum kaIndexFormat format;
+	enum kaUsage usage;
+};
+
+struct kaVertexArray
+{
+	unsigned int glptr; // Zero when emulated
+
+	const struct kaVertices* vertices; // Or slots, with a layout
+	const struct kaVertexLayout* layout;
+	const struct kaVertices* slots[KA_MAX_LAYOUT_SLOTS];
+	const struct kaIndex* index;
+
+	struct
+	{
+		unsigned int element_buffer;
+		uint32_t attributes;
+		size_t base_vertex;
+		uint32_t deletions; // Of buffers in the window when saved, to know if 'element_buffer' is stale
+	} bound;                // State within, a cache mutable even through const pointers
+};
+
+struct kaInstance
+{
+	struct jaMatrixF4 local; // Applied after kaSetLocal()
+	struct kaRgba color;
+};
+
+struct kaInstances
+{
+	unsigned int glptr;
+	size_t length;           // In elements
+	struct kaInstance* copy; // Only when instancing is emulated
 };
 
 enum kaTextureFilter
@@ -190,11 +322,177 @@ enum kaTextureWrap
 	KA_MIRRORED_REPEAT
 };
 
+enum kaMipmapFilter
+{
+	KA_MIPMAP_BOX,
+	KA_MIPMAP_KAISER // Sharper, slower
+};
+
+enum kaLoadState
+{
+	KA_LOAD_PENDING,
+	KA_LOAD_READY,
+	KA_LOAD_FAILED
+};
+
 struct kaTexture
 {
 	unsigned int glptr;
 	enum kaTextureFilter filter;
 	enum kaTextureWrap wrap;
+	enum kaMipmapFilter mipmap;
+	bool srgb;           // Mipmaps averaged in linear space
+	size_t residency_id; // Plus one, zero if not from a kaResidency
+};
+
+struct kaResidencyStatistics
+{
+	size_t budget; // In bytes
+	size_t bytes;  // "
+
+	size_t textures;
+	size_t full;    // At full resolution
+	size_t reduced; // Without top levels
+	size_t evicted; // A placeholder in its place
+
+	size_t evictions;  // Since creation
+	size_t reductions; // "
+	size_t streams;    // "
+};
+
+struct kaCommandBuffer
+{
+	uint8_t* data;
+	size_t length;   // In bytes
+	size_t capacity; // "
+
+	// Last recorded state, to strip redundant changes
+	const struct kaProgram* program;
+	const struct kaVertices* vertices;
+	const struct kaTexture* texture[8]; // Per unit
+
+	struct jaMatrixF4 world;
+	struct jaMatrixF4 local;
+	bool has_world;
+	bool has_local;
+	size_t pending_world; // Offset of a matrix that no draw used yet, zero if none
+	size_t pending_local; // "
+};
+
+struct kaStatistics
+{
+	size_t draws;
+	size_t state_changes;           // Issued to GL
+	size_t redundant_state_changes; // Filtered, never reached GL
+
+	size_t uniform_uploads;
+	size_t avoided_uniform_uploads; // Values that changed again before a draw
+
+	size_t culled; // Draws skipped by kaDrawCulled()
+
+	size_t texture_uploads; // Regions, level zero only
+	size_t texture_bytes;   // "
+};
+
+struct kaGeometryRange
+{
+	size_t offset; // In elements
+	size_t length; // "
+};
+
+struct kaGeometryFreeList
+{
+	struct kaGeometryRange* ranges; // Sorted by offset, never adjacent
+	size_t length;
+	size_t capacity;
+};
+
+struct kaGeometry
+{
+	struct kaVertices vertices; // To use with kaSetVertices()
+	struct kaIndex index;       // To use with kaDrawRange()
+
+	size_t max_vertices;
+	struct kaGeometryFreeList free_vertices;
+	struct kaGeometryFreeList free_index;
+};
+
+struct kaMesh
+{
+	size_t first_index;
+	size_t count; // Of indices
+	size_t base_vertex;
+	size_t vertices_length;
+};
+
+struct kaRing
+{
+	struct kaVertices vertices; // To use with kaSetVertices() and kaDrawRange(), only one of them
+	struct kaIndex index;       // has a buffer, as the ring was initialized
+
+	size_t cursor; // In elements
+	size_t capacity;
+};
+
+struct kaAtlasNode
+{
+	size_t x;
+	size_t y; // Skyline height from here
+	size_t width;
+};
+
+struct kaAtlasPage
+{
+	struct kaTexture texture;
+	struct kaAtlasNode* skyline; // Sorted by x, covering all the width
+	size_t skyline_length;
+	size_t skyline_capacity;
+	bool dirty; // Mipmaps need to be generated
+};
+
+struct kaAtlas
+{
+	struct kaAtlasPage** pages; // Individually allocated, keeping textures addresses
+	size_t pages_length;
+
+	size_t width;   // Of every page
+	size_t height;  // "
+	size_t padding; // Extruded pixels around each image
+	enum kaTextureFilter filter;
+};
+
+struct kaAtlasSprite
+{
+	const struct kaTexture* texture; // Of the page where it lives
+	struct kaAABRectangle uv;
+};
+
+struct kaBatch
+{
+	struct kaVertices vertices;
+	struct kaIndex index; // Shared by all quads, never changes
+
+	struct kaVertex* staging;
+	size_t length;     // In quads
+	size_t max_length; // "
+
+	const struct kaTexture* texture;
+	const struct kaProgram* program;
+};
+
+struct kaRenderTarget
+{
+	unsigned int framebuffer;
+	unsigned int depth; // Renderbuffer, zero if none
+
+	unsigned int msaa_framebuffer; // Zero if not multisampled
+	unsigned int msaa_color;       // Renderbuffers, "
+	unsigned int msaa_depth;       // "
+
+	struct kaTexture texture; // Color, to sample after a resolve
+	size_t width;
+	size_t height;
+	int samples;
 };
 
 // context/sdl2.c
@@ -227,25 +525,114 @@ KA_EXPORT bool kaWindowInFocus(const struct kaWindow*);
 
 KA_EXPORT int kaProgramInit(struct kaWindow*, const char* vertex_code, const char* fragment_code, struct kaProgram* out,
                             struct jaStatus*);
-KA_EXPORT int kaVerticesInit(struct kaWindow*, const struct kaVertex* data, uint16_t length, struct kaVertices* out,
+KA_EXPORT int kaVertexLayoutInit(const struct kaAttribute* attributes, size_t length, struct kaVertexLayout* out,
+                                 struct jaStatus*);
+KA_EXPORT int kaProgramInitLayout(struct kaWindow*, const char* vertex_code, const char* fragment_code,
+                                  const struct kaVertexLayout*, struct kaProgram* out, struct jaStatus*);
+KA_EXPORT int kaVerticesInitData(struct kaWindow*, const void* data, size_t stride, size_t length,
+                                 struct kaVertices* out, struct jaStatus*); // For layouts
+KA_EXPORT int kaVerticesInit(struct kaWindow*, const struct kaVertex* data, size_t length, struct kaVertices* out,
                              struct jaStatus*);
+KA_EXPORT int kaVerticesInitUsage(struct kaWindow*, const struct kaVertex* data, size_t length, enum kaUsage,
+                                  struct kaVertices* out, struct jaStatus*);
+KA_EXPORT int kaVerticesInitBulk(struct kaWindow*, size_t count, const struct kaVertex* const* data,
+                                 const size_t* length, struct kaVertices* out, struct jaStatus*); // Data can be NULL
+KA_EXPORT void kaVerticesUpdate(struct kaWindow*, const void* data, size_t offset, size_t length,
+                                struct kaVertices* out); // Data in the format of 'out', all of it orphans
+KA_EXPORT int kaVerticesInitCompact(struct kaWindow*, const struct kaVertexCompact* data, size_t length,
+                                    struct kaVertices* out, struct jaStatus*);
+KA_EXPORT int kaVerticesInitQuantized(struct kaWindow*, const struct kaVertex* data, size_t length,
+                                      struct kaVertices* out, struct jaStatus*); // Within bounds of data
+KA_EXPORT struct kaVertexCompact kaVertexToCompact(struct kaVertex); // Uv clamped from 0 to 1
 KA_EXPORT int kaIndexInit(struct kaWindow*, const uint16_t* data, size_t length, struct kaIndex* out, struct jaStatus*);
+KA_EXPORT int kaIndexInitUsage(struct kaWindow*, const uint16_t* data, size_t length, enum kaUsage,
+                               struct kaIndex* out, struct jaStatus*);
+KA_EXPORT int kaIndexInitBulk(struct kaWindow*, size_t count, const uint16_t* const* data, const size_t* length,
+                              struct kaIndex* out, struct jaStatus*);
+KA_EXPORT void kaIndexUpdate(struct kaWindow*, const void* data, size_t offset, size_t length, struct kaIndex* out);
+KA_EXPORT int kaIndexInit32(struct kaWindow*, const uint32_t* data, size_t length, struct kaIndex* out,
+                            struct jaStatus*); // Fails without GLES3 or 'GL_OES_element_index_uint'
+KA_EXPORT int kaInstancesInit(struct kaWindow*, const struct kaInstance* data, size_t length, struct kaInstances* out,
+                              struct jaStatus*);
+KA_EXPORT void kaInstancesUpdate(struct kaWindow*, const struct kaInstance* data, size_t offset, size_t length,
+                                 struct kaInstances* out);
+KA_EXPORT int kaVertexArrayInit(struct kaWindow*, const struct kaVertices*, const struct kaIndex*,
+                                struct kaVertexArray* out, struct jaStatus*);
+KA_EXPORT int kaVertexArrayInitLayout(struct kaWindow*, const struct kaVertexLayout*,
+                                      const struct kaVertices* const* slots, const struct kaIndex*,
+                                      struct kaVertexArray* out, struct jaStatus*);
 KA_EXPORT int kaTextureInitImage(struct kaWindow*, const struct jaImage* image, enum kaTextureFilter,
                                  enum kaTextureWrap, struct kaTexture* out, struct jaStatus*);
+KA_EXPORT int kaTextureInitMipmaps(struct kaWindow*, const struct jaImage* image, enum kaTextureFilter,
+                                   enum kaTextureWrap, enum kaMipmapFilter, bool srgb, struct kaTexture* out,
+                                   struct jaStatus*);
+KA_EXPORT int kaTextureInitBulk(struct kaWindow*, size_t count, const struct jaImage* const* images,
+                                enum kaTextureFilter, enum kaTextureWrap, struct kaTexture* out, struct jaStatus*);
 KA_EXPORT int kaTextureInitFilename(struct kaWindow*, const char* filename, enum kaTextureFilter, enum kaTextureWrap,
                                     struct kaTexture* out, struct jaStatus*);
 KA_EXPORT void kaTextureUpdate(struct kaWindow*, const struct jaImage* image, size_t x, size_t y, size_t width,
-                               size_t height, struct kaTexture* out);
+                               size_t height, struct kaTexture* out); // Image of the whole texture
 
 KA_EXPORT void kaProgramFree(struct kaWindow*, struct kaProgram*);
 KA_EXPORT void kaVerticesFree(struct kaWindow*, struct kaVertices*);
 KA_EXPORT void kaIndexFree(struct kaWindow*, struct kaIndex*);
+KA_EXPORT void kaVertexArrayFree(struct kaWindow*, struct kaVertexArray*);
+KA_EXPORT void kaInstancesFree(struct kaWindow*, struct kaInstances*);
 KA_EXPORT void kaTextureFree(struct kaWindow*, struct kaTexture*);
 
+// context/dirty.c
+
+KA_EXPORT void kaTextureMark(struct kaWindow*, const struct jaImage* image, size_t x, size_t y, size_t width,
+                             size_t height, struct kaTexture*); // Uploaded before the next draw, or at frame end
+
+// context/compressed.c
+
+// KTX containers, 2d and with compressed formats. ETC1 is taken as intermediate
+// format, when the driver lacks it is uploaded as ETC2, transcoded to S3TC or
+// as last resort decoded. Compressed textures can't be updated
+KA_EXPORT int kaTextureInitKtx(struct kaWindow*, const char* filename, enum kaTextureFilter, enum kaTextureWrap,
+                               struct kaTexture* out, struct jaStatus*);
+KA_EXPORT int kaTextureInitKtxMemory(struct kaWindow*, const void* data, size_t size, enum kaTextureFilter,
+                                     enum kaTextureWrap, struct kaTexture* out, struct jaStatus*);
+
+// context/loader.c
+
+// Files are read and decoded by background threads, uploaded by kaContextUpdate()
+// before the frame callback, only as many bytes as 'kansai.upload_budget' (KiB)
+// allows per frame. The callback is called then, with the texture ready or not
+KA_EXPORT struct kaTextureLoad* kaTextureLoadAsync(struct kaWindow*, const char* filename, enum kaTextureFilter,
+                                                   enum kaTextureWrap,
+                                                   void (*callback)(struct kaWindow*, struct kaTextureLoad*, void*),
+                                                   void* user_data, struct jaStatus*); // Ktx files by extension
+KA_EXPORT void kaTextureLoadDelete(struct kaWindow*, struct kaTextureLoad*); // Cancels, or frees the texture
+
+KA_EXPORT enum kaLoadState kaTextureLoadState(const struct kaTextureLoad*, struct jaStatus* out); // Out for failures
+KA_EXPORT const struct kaTexture* kaTextureLoadGet(const struct kaWindow*,
+                                                   const struct kaTextureLoad*); // Default texture until ready
+
+// context/residency.c
+
+// Textures streamed from disk when bound, and evicted when the bytes of all of
+// them exceed a budget, least recently used first. Ones used not long ago just
+// lose their top levels. The texture name changes, so 'out' needs to outlive
+// its residency, and only can be freed by kaResidencyRemove()
+KA_EXPORT struct kaResidency* kaResidencyCreate(struct kaWindow*, size_t budget, struct jaStatus*); // One per window
+KA_EXPORT void kaResidencyDelete(struct kaWindow*, struct kaResidency*);
+
+KA_EXPORT int kaResidencyAdd(struct kaWindow*, struct kaResidency*, const char* filename, enum kaTextureFilter,
+                             enum kaTextureWrap, struct kaTexture* out, struct jaStatus*);
+KA_EXPORT void kaResidencyRemove(struct kaWindow*, struct kaResidency*, struct kaTexture*);
+
+KA_EXPORT void kaResidencySetBudget(struct kaResidency*, size_t budget);
+KA_EXPORT struct kaResidencyStatistics kaResidencyGetStatistics(const struct kaResidency*);
+
 // context/state.c
 
 KA_EXPORT void kaSetProgram(struct kaWindow*, const struct kaProgram*);
 KA_EXPORT void kaSetVertices(struct kaWindow*, const struct kaVertices*);
+KA_EXPORT void kaSetVerticesLayout(struct kaWindow*, const struct kaVertexLayout*,
+                                   const struct kaVertices* const* slots); // As many slots as layout requires
+KA_EXPORT void kaSetVertexArray(struct kaWindow*, const struct kaVertexArray*); // Draw with its index afterwards
 KA_EXPORT void kaSetTexture(struct kaWindow*, int unit, const struct kaTexture*);
 
 KA_EXPORT void kaSetWorld(struct kaWindow*, struct jaMatrixF4);
@@ -254,8 +641,121 @@ KA_EXPORT void kaSetCameraMatrix(struct kaWindow*, struct jaMatrixF4 matrix, str
 KA_EXPORT void kaSetLocal(struct kaWindow*, struct jaMatrixF4);
 
 KA_EXPORT void kaSetCleanColor(struct kaWindow*, struct kaRgb);
+KA_EXPORT void kaSetBlend(struct kaWindow*, bool enable);
+KA_EXPORT void kaSetDepthTest(struct kaWindow*, bool enable);
+KA_EXPORT void kaSetCullFace(struct kaWindow*, bool enable);
+
+KA_EXPORT void kaGetStatistics(const struct kaWindow*, struct kaStatistics* out); // Of previous frame
 
 KA_EXPORT void kaDraw(struct kaWindow*, const struct kaIndex*);
 KA_EXPORT void kaDrawDefault(struct kaWindow*);
+KA_EXPORT void kaDrawInstanced(struct kaWindow*, const struct kaIndex*, const struct kaInstances*,
+                               size_t count); // Quantized vertices need a program with dequantize uniforms
+KA_EXPORT void kaDrawDefaultInstanced(struct kaWindow*, const struct kaInstances*, size_t count);
+KA_EXPORT void kaDrawRange(struct kaWindow*, const struct kaIndex*, size_t first, size_t count, size_t base_vertex);
+KA_EXPORT void kaDrawCulled(struct kaWindow*, const struct kaIndex*, struct kaAABBox bounds); // Bounds before local
+KA_EXPORT void kaGetFrustum(struct kaWindow*, struct kaFrustum* out); // Of world and camera
+
+// context/queue.c
+
+KA_EXPORT void kaQueueDraw(struct kaWindow*, int layer, bool translucent, const struct kaProgram*,
+                           const struct kaTexture*, const struct kaVertices*, const struct kaIndex*,
+                           struct jaMatrixF4 local); // Drawn with current world and camera
+
+// context/commands.c
+
+KA_EXPORT int kaCommandSetProgram(struct kaCommandBuffer*, const struct kaProgram*);
+KA_EXPORT int kaCommandSetVertices(struct kaCommandBuffer*, const struct kaVertices*);
+KA_EXPORT int kaCommandSetTexture(struct kaCommandBuffer*, int unit, const struct kaTexture*);
+KA_EXPORT int kaCommandSetWorld(struct kaCommandBuffer*, struct jaMatrixF4);
+KA_EXPORT int kaCommandSetLocal(struct kaCommandBuffer*, struct jaMatrixF4);
+KA_EXPORT int kaCommandDraw(struct kaCommandBuffer*, const struct kaIndex*);
+KA_EXPORT int kaCommandDrawDefault(struct kaCommandBuffer*);
+
+KA_EXPORT void kaCommandBufferClear(struct kaCommandBuffer*); // To record again
+KA_EXPORT void kaCommandBufferFree(struct kaCommandBuffer*);
+KA_EXPORT void kaCommandBufferSubmit(struct kaWindow*, const struct kaCommandBuffer*);
+
+// Recording never calls GL, so each thread can record its own buffer. Enqueue is thread
+// safe, buffers get submitted sorted by order when the frame ends, untouched until then.
+// Orders are unique per frame, a repeated one fails, as no other key would be deterministic
+KA_EXPORT int kaCommandBufferEnqueue(struct kaWindow*, const struct kaCommandBuffer*, int order, struct jaStatus*);
+
+// context/batch.c
+
+KA_EXPORT int kaBatchInit(struct kaWindow*, size_t max_quads, struct kaBatch* out, struct jaStatus*);
+KA_EXPORT void kaBatchFree(struct kaWindow*, struct kaBatch*);
+
+KA_EXPORT void kaBatchQuad(struct kaWindow*, struct kaBatch*, const struct kaTexture*, struct jaMatrixF4 local,
+                           struct kaAABRectangle uv, struct kaRgba tint);
+KA_EXPORT void kaBatchFlush(struct kaWindow*, struct kaBatch*);
+
+// context/geometry.c
+
+// Many meshes sharing one vertex buffer and one index buffer, so drawing them
+// needs no binds, values in each mesh index are relative to its base vertex
+KA_EXPORT int kaGeometryInit(struct kaWindow*, size_t max_vertices, size_t max_indices, struct kaGeometry* out,
+                             struct jaStatus*);
+KA_EXPORT void kaGeometryFree(struct kaWindow*, struct kaGeometry*);
+
+KA_EXPORT int kaGeometryAdd(struct kaWindow*, struct kaGeometry*, const struct kaVertex* vertices,
+                            uint16_t vertices_length, const uint16_t* index, size_t index_length, struct kaMesh* out,
+                            struct jaStatus*);
+KA_EXPORT void kaGeometryRemove(struct kaGeometry*, const struct kaMesh*);
+KA_EXPORT void kaDrawMesh(struct kaWindow*, const struct kaGeometry*, const struct kaMesh*);
+
+// context/ring.c
+
+// Streaming, each push takes a region not overlapping with previous ones until
+// the ring wraps around, orphaning its storage. Draws that were already issued
+// keep reading what they had, but deferred ones (queue, command buffers) need a
+// ring large enough for a frame
+KA_EXPORT int kaRingInitVertices(struct kaWindow*, size_t max_length, struct kaRing* out, struct jaStatus*);
+KA_EXPORT int kaRingInitIndex(struct kaWindow*, size_t max_length, struct kaRing* out, struct jaStatus*);
+KA_EXPORT void kaRingFree(struct kaWindow*, struct kaRing*);
+
+KA_EXPORT int kaRingPushVertices(struct kaWindow*, struct kaRing*, const struct kaVertex* data, size_t length,
+                                 size_t* out_base_vertex);
+KA_EXPORT int kaRingPushIndex(struct kaWindow*, struct kaRing*, const uint16_t* data, size_t length,
+                              size_t* out_first_index);
+
+// context/atlas.c
+
+// Many images packed into few textures, so batched draws of different sprites
+// share a bind. Images are converted to RGBA, and its borders extruded to avoid
+// bleeding with filters. Mipmaps are only generated by kaAtlasCommit()
+KA_EXPORT int kaAtlasInit(struct kaWindow*, size_t width, size_t height, size_t padding, enum kaTextureFilter,
+                          struct kaAtlas* out, struct jaStatus*);
+KA_EXPORT void kaAtlasFree(struct kaWindow*, struct kaAtlas*);
+
+KA_EXPORT int kaAtlasAdd(struct kaWindow*, struct kaAtlas*, const struct jaImage* image, struct kaAtlasSprite* out,
+                         struct jaStatus*); // Creates a new page if no one has space
+KA_EXPORT void kaAtlasCommit(struct kaWindow*, struct kaAtlas*);
+
+// context/occlusion.c
+
+KA_EXPORT struct kaOcclusion* kaOcclusionCreate(int width, int height, struct jaStatus*);
+KA_EXPORT void kaOcclusionDelete(struct kaOcclusion*);
+
+KA_EXPORT void kaOcclusionBegin(struct kaWindow*, struct kaOcclusion*); // Clears, takes world and camera from window
+KA_EXPORT void kaOcclusionDraw(struct kaOcclusion*, struct jaMatrixF4 local, const struct kaVertex* vertices,
+                               uint16_t vertices_length, const uint16_t* index, size_t index_length);
+KA_EXPORT void kaOcclusionEnd(struct kaOcclusion*); // Rasterizes, blocks until done
+
+KA_EXPORT bool kaOcclusionTestBox(const struct kaOcclusion*, struct kaAABBox); // True if visible, box in world space
+KA_EXPORT void kaOcclusionCullBoxes(const struct kaOcclusion*, const struct kaAABBox* boxes, size_t length,
+                                    uint32_t* out); // Bitmask as kaFrustumCullBoxes()
+
+// context/target.c
+
+KA_EXPORT int kaRenderTargetInit(struct kaWindow*, size_t width, size_t height, bool depth, int samples,
+                                 enum kaTextureFilter, enum kaTextureWrap, struct kaRenderTarget* out,
+                                 struct jaStatus*); // Samples reduced to what GL supports, one without multisampling
+KA_EXPORT void kaRenderTargetFree(struct kaWindow*, struct kaRenderTarget*);
+
+KA_EXPORT void kaRenderTargetBind(struct kaWindow*, const struct kaRenderTarget*,
+                                  bool clear); // Draws go there, queued ones flushed first
+KA_EXPORT void kaRenderTargetUnbind(struct kaWindow*); // Back to the window, also done at frame end
+KA_EXPORT void kaRenderTargetResolve(struct kaWindow*, struct kaRenderTarget*); // Makes draws visible in its texture
 
 #endif
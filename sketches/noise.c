@@ -144,7 +144,7 @@ static void sFrame(struct kaWindow* w, struct kaEvents e, float delta, void* use
 	if (current > (data->previous_median + (1000 / 12))) // 12 fps
 	{
 		sMedian(data);
-		kaTextureUpdate(w, data->image, 0, 0, data->image->width, data->image->height, &data->texture);
+		kaTextureMark(w, data->image, 0, 0, data->image->width, data->image->height, &data->texture);
 		data->previous_median = current;
 	}
 
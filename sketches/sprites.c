@@ -0,0 +1,130 @@
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "japan-matrix.h"
+#include "japan-vector.h"
+#include "kansai-context.h"
+#include "kansai-random.h"
+
+#define NAME "Sprites"
+#define SPRITES_NO 10000
+
+
+struct Sprite
+{
+	struct jaVectorF2 position;
+	struct jaVectorF2 speed;
+	struct kaRgba color;
+};
+
+
+struct WindowData
+{
+	struct kaXorshift rng;
+	struct kaBatch batch;
+	struct Sprite sprites[SPRITES_NO];
+	float phase;
+};
+
+
+static inline float sRandomFloat(struct kaXorshift* rng)
+{
+	return (float)(kaRandom(rng) % 1024) / 1023.0f;
+}
+
+
+static void sInit(struct kaWindow* w, void* user_data, struct jaStatus* st)
+{
+	struct WindowData* data = user_data;
+
+	kaSeed(&data->rng, 0);
+	kaSetCameraMatrix(w, jaMatrixOrthographicF4(-1.0f, +1.0f, -1.0f, +1.0f, 0.0f, 2.0f),
+	                  (struct jaVectorF3){0.0f, 0.0f, 0.0f});
+
+	if (kaBatchInit(w, SPRITES_NO, &data->batch, st) != 0)
+		return;
+
+	for (size_t i = 0; i < SPRITES_NO; i++)
+	{
+		data->sprites[i].position.x = sRandomFloat(&data->rng) * 2.0f - 1.0f;
+		data->sprites[i].position.y = sRandomFloat(&data->rng) * 2.0f - 1.0f;
+		data->sprites[i].speed.x = (sRandomFloat(&data->rng) - 0.5f) / 100.0f;
+		data->sprites[i].speed.y = (sRandomFloat(&data->rng) - 0.5f) / 100.0f;
+		data->sprites[i].color = kaRgbaRandom(&data->rng, 1.0f);
+	}
+}
+
+
+static void sFrame(struct kaWindow* w, struct kaEvents e, float delta, void* user_data, struct jaStatus* st)
+{
+	(void)e;
+	(void)st;
+
+	struct WindowData* data = user_data;
+	struct jaMatrixF4 m;
+
+	for (size_t i = 0; i < SPRITES_NO; i++)
+	{
+		struct Sprite* s = &data->sprites[i];
+
+		s->position = jaVectorAddF2(s->position, jaVectorScaleF2(s->speed, delta));
+
+		if (s->position.x < -1.0f || s->position.x > 1.0f)
+			s->speed.x = -s->speed.x;
+		if (s->position.y < -1.0f || s->position.y > 1.0f)
+			s->speed.y = -s->speed.y;
+
+		m = jaMatrixTranslationF4((struct jaVectorF3){s->position.x, s->position.y, 0.0f});
+		m = jaMatrixRotateZF4(m, data->phase + (float)i);
+		m = jaMatrixScaleAnsioF4(m, (struct jaVectorF3){0.02f, 0.02f, 1.0f});
+
+		kaBatchQuad(w, &data->batch, NULL, m, (struct kaAABRectangle){{0.0f, 0.0f}, {1.0f, 1.0f}}, s->color);
+	}
+
+	data->phase += 0.05f * delta;
+}
+
+
+static void sClose(struct kaWindow* w, void* user_data)
+{
+	struct WindowData* data = user_data;
+	kaBatchFree(w, &data->batch);
+}
+
+
+int main()
+{
+	struct jaStatus st = {0};
+	struct WindowData* data = calloc(1, sizeof(struct WindowData));
+
+	if (data == NULL)
+		return EXIT_FAILURE;
+
+	if (kaContextStart(&st) != 0)
+		goto return_failure;
+
+	if (kaWindowCreate(NULL, sInit, sFrame, NULL, NULL, NULL, sClose, data, &st) != 0)
+		goto return_failure;
+
+	while (1)
+	{
+		if (kaContextUpdate(&st) != 0)
+			break;
+	}
+
+	if (st.code != JA_STATUS_SUCCESS)
+		goto return_failure;
+
+	// Bye!
+	kaContextStop();
+	free(data);
+	return EXIT_SUCCESS;
+
+return_failure:
+	jaStatusPrint(NAME, st);
+	kaContextStop();
+	free(data);
+	return EXIT_FAILURE;
+}
@@ -98,3 +98,193 @@ inline struct jaVectorF3 kaAABMiddleBox(struct kaAABBox box)
 	                          .y = (box.min.y + (box.max.y - box.min.y) / 2.0f),
 	                          .z = (box.min.z + (box.max.z - box.min.z) / 2.0f)};
 }
+
+
+struct kaFrustum kaFrustumFromMatrix(struct jaMatrixF4 m)
+{
+	// Gribb & Hartmann, combining rows of the matrix ('e[column][row]') where
+	// clip space goes from -w to +w in all axes, as GL does
+	struct kaFrustum f;
+
+	for (int i = 0; i < 6; i++)
+	{
+		const int row = i / 2;
+		const float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+
+		f.plane[i].normal.x = m.e[0][3] + sign * m.e[0][row];
+		f.plane[i].normal.y = m.e[1][3] + sign * m.e[1][row];
+		f.plane[i].normal.z = m.e[2][3] + sign * m.e[2][row];
+		f.plane[i].d = m.e[3][3] + sign * m.e[3][row];
+
+		const float length = sqrtf(f.plane[i].normal.x * f.plane[i].normal.x +
+		                           f.plane[i].normal.y * f.plane[i].normal.y +
+		                           f.plane[i].normal.z * f.plane[i].normal.z);
+
+		if (length > 0.0f)
+		{
+			f.plane[i].normal.x /= length;
+			f.plane[i].normal.y /= length;
+			f.plane[i].normal.z /= length;
+			f.plane[i].d /= length;
+		}
+	}
+
+	return f;
+}
+
+
+inline bool kaFrustumTestBox(const struct kaFrustum* f, struct kaAABBox box)
+{
+	for (int i = 0; i < 6; i++)
+	{
+		// Corner furthest along the normal, if outside the entire box is
+		const struct kaPlane* p = &f->plane[i];
+
+		if (p->normal.x * ((p->normal.x > 0.0f) ? box.max.x : box.min.x) +
+		        p->normal.y * ((p->normal.y > 0.0f) ? box.max.y : box.min.y) +
+		        p->normal.z * ((p->normal.z > 0.0f) ? box.max.z : box.min.z) + p->d <
+		    0.0f)
+			return false;
+	}
+
+	return true;
+}
+
+
+inline bool kaFrustumTestSphere(const struct kaFrustum* f, struct kaSphere s)
+{
+	for (int i = 0; i < 6; i++)
+	{
+		const struct kaPlane* p = &f->plane[i];
+
+		if (p->normal.x * s.origin.x + p->normal.y * s.origin.y + p->normal.z * s.origin.z + p->d < -s.radius)
+			return false;
+	}
+
+	return true;
+}
+
+
+// Batch culling, planes laid out to test four at a time, a box as its
+// middle point and extent, a sphere as a box of extent zero and a bias
+
+struct Planes
+{
+	float nx[8], ny[8], nz[8], d[8];
+	float abs_nx[8], abs_ny[8], abs_nz[8];
+};
+
+static void sPlanes(const struct kaFrustum* f, struct Planes* out)
+{
+	for (int i = 0; i < 8; i++)
+	{
+		// Last two planes as padding, always passing
+		const struct kaPlane p = (i < 6) ? f->plane[i] : (struct kaPlane){.normal = {0.0f, 0.0f, 0.0f}, .d = 1.0f};
+
+		out->nx[i] = p.normal.x;
+		out->ny[i] = p.normal.y;
+		out->nz[i] = p.normal.z;
+		out->d[i] = p.d;
+		out->abs_nx[i] = fabsf(p.normal.x);
+		out->abs_ny[i] = fabsf(p.normal.y);
+		out->abs_nz[i] = fabsf(p.normal.z);
+	}
+}
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+
+static inline bool sOutside(const struct Planes* p, struct jaVectorF3 middle, struct jaVectorF3 extent, float bias)
+{
+	const __m128 mx = _mm_set1_ps(middle.x), my = _mm_set1_ps(middle.y), mz = _mm_set1_ps(middle.z);
+	const __m128 ex = _mm_set1_ps(extent.x), ey = _mm_set1_ps(extent.y), ez = _mm_set1_ps(extent.z);
+	__m128 outside = _mm_setzero_ps();
+
+	for (int i = 0; i < 8; i += 4)
+	{
+		__m128 dist = _mm_add_ps(_mm_loadu_ps(p->d + i), _mm_set1_ps(bias));
+		dist = _mm_add_ps(dist, _mm_mul_ps(_mm_loadu_ps(p->nx + i), mx));
+		dist = _mm_add_ps(dist, _mm_mul_ps(_mm_loadu_ps(p->ny + i), my));
+		dist = _mm_add_ps(dist, _mm_mul_ps(_mm_loadu_ps(p->nz + i), mz));
+		dist = _mm_add_ps(dist, _mm_mul_ps(_mm_loadu_ps(p->abs_nx + i), ex));
+		dist = _mm_add_ps(dist, _mm_mul_ps(_mm_loadu_ps(p->abs_ny + i), ey));
+		dist = _mm_add_ps(dist, _mm_mul_ps(_mm_loadu_ps(p->abs_nz + i), ez));
+		outside = _mm_or_ps(outside, _mm_cmplt_ps(dist, _mm_setzero_ps()));
+	}
+
+	return (_mm_movemask_ps(outside) != 0);
+}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+
+static inline bool sOutside(const struct Planes* p, struct jaVectorF3 middle, struct jaVectorF3 extent, float bias)
+{
+	uint32x4_t outside = vdupq_n_u32(0);
+
+	for (int i = 0; i < 8; i += 4)
+	{
+		float32x4_t dist = vaddq_f32(vld1q_f32(p->d + i), vdupq_n_f32(bias));
+		dist = vmlaq_n_f32(dist, vld1q_f32(p->nx + i), middle.x);
+		dist = vmlaq_n_f32(dist, vld1q_f32(p->ny + i), middle.y);
+		dist = vmlaq_n_f32(dist, vld1q_f32(p->nz + i), middle.z);
+		dist = vmlaq_n_f32(dist, vld1q_f32(p->abs_nx + i), extent.x);
+		dist = vmlaq_n_f32(dist, vld1q_f32(p->abs_ny + i), extent.y);
+		dist = vmlaq_n_f32(dist, vld1q_f32(p->abs_nz + i), extent.z);
+		outside = vorrq_u32(outside, vcltq_f32(dist, vdupq_n_f32(0.0f)));
+	}
+
+	const uint32x2_t r = vorr_u32(vget_low_u32(outside), vget_high_u32(outside));
+	return ((vget_lane_u32(r, 0) | vget_lane_u32(r, 1)) != 0);
+}
+
+#else
+static inline bool sOutside(const struct Planes* p, struct jaVectorF3 middle, struct jaVectorF3 extent, float bias)
+{
+	for (int i = 0; i < 6; i++)
+	{
+		if (p->d[i] + bias + p->nx[i] * middle.x + p->ny[i] * middle.y + p->nz[i] * middle.z +
+		        p->abs_nx[i] * extent.x + p->abs_ny[i] * extent.y + p->abs_nz[i] * extent.z <
+		    0.0f)
+			return true;
+	}
+
+	return false;
+}
+#endif
+
+
+static inline void sSetBit(uint32_t* out, size_t i, bool visible)
+{
+	if ((i % 32) == 0)
+		out[i / 32] = 0;
+
+	if (visible == true)
+		out[i / 32] |= (uint32_t)1 << (i % 32);
+}
+
+
+void kaFrustumCullBoxes(const struct kaFrustum* f, const struct kaAABBox* boxes, size_t length, uint32_t* out)
+{
+	struct Planes p;
+	sPlanes(f, &p);
+
+	for (size_t i = 0; i < length; i++)
+	{
+		const struct jaVectorF3 extent = {(boxes[i].max.x - boxes[i].min.x) / 2.0f,
+		                                  (boxes[i].max.y - boxes[i].min.y) / 2.0f,
+		                                  (boxes[i].max.z - boxes[i].min.z) / 2.0f};
+
+		sSetBit(out, i, !sOutside(&p, kaAABMiddleBox(boxes[i]), extent, 0.0f));
+	}
+}
+
+
+void kaFrustumCullSpheres(const struct kaFrustum* f, const struct kaSphere* spheres, size_t length, uint32_t* out)
+{
+	struct Planes p;
+	sPlanes(f, &p);
+
+	for (size_t i = 0; i < length; i++)
+		sSetBit(out, i, !sOutside(&p, spheres[i].origin, (struct jaVectorF3){0.0f, 0.0f, 0.0f}, spheres[i].radius));
+}
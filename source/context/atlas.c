@@ -0,0 +1,358 @@
+/*-----------------------------
+
+MIT License
+
+Copyright (c) 2020 Alexander Brandt
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-------------------------------
+
+ [context/atlas.c]
+ - Alexander Brandt 2020
+-----------------------------*/
+
+#include "private.h"
+
+
+static int sNewPage(struct kaWindow* window, struct kaAtlas* atlas, struct jaStatus* st)
+{
+	struct kaAtlasPage** pages = NULL;
+	struct kaAtlasPage* page = NULL;
+
+	// Blank storage, filled by each image
+	const struct jaImage blank = {
+	    .width = atlas->width, .height = atlas->height, .channels = 4, .format = JA_IMAGE_U8, .data = NULL};
+
+	if ((pages = realloc(atlas->pages, sizeof(struct kaAtlasPage*) * (atlas->pages_length + 1))) == NULL)
+		goto return_failure;
+
+	atlas->pages = pages;
+
+	if ((page = calloc(1, sizeof(struct kaAtlasPage))) == NULL)
+		goto return_failure;
+
+	if ((page->skyline = malloc(sizeof(struct kaAtlasNode) * 16)) == NULL) // HARDCODED
+		goto return_failure;
+
+	page->skyline[0] = (struct kaAtlasNode){.x = 0, .y = 0, .width = atlas->width};
+	page->skyline_length = 1;
+	page->skyline_capacity = 16;
+
+	if (kaTextureInitImage(window, &blank, atlas->filter, KA_CLAMP, &page->texture, st) != 0)
+	{
+		free(page->skyline);
+		free(page);
+		return 1;
+	}
+
+	atlas->pages[atlas->pages_length] = page;
+	atlas->pages_length += 1;
+	return 0;
+
+return_failure:
+	if (page != NULL)
+	{
+		free(page->skyline);
+		free(page);
+	}
+
+	jaStatusSet(st, "kaAtlasAdd", JA_STATUS_MEMORY_ERROR, NULL);
+	return 1;
+}
+
+
+static bool sFit(const struct kaAtlasPage* page, size_t i, size_t width, size_t height, size_t page_width,
+                 size_t page_height, size_t* out_y)
+{
+	size_t y = 0;
+
+	if (page->skyline[i].x + width > page_width)
+		return false;
+
+	// Rest on the highest node below the rectangle
+	for (size_t remaining = width; remaining > 0 && i < page->skyline_length; i++)
+	{
+		if (page->skyline[i].y > y)
+			y = page->skyline[i].y;
+
+		if (y + height > page_height)
+			return false;
+
+		remaining = (page->skyline[i].width >= remaining) ? 0 : remaining - page->skyline[i].width;
+	}
+
+	*out_y = y;
+	return true;
+}
+
+
+static int sPlace(struct kaAtlasPage* page, size_t width, size_t height, size_t page_width, size_t page_height,
+                  size_t* out_x, size_t* out_y)
+{
+	size_t best = SIZE_MAX;
+	size_t best_top = SIZE_MAX;
+	size_t best_width = SIZE_MAX;
+	size_t y = 0;
+
+	// Bottom left heuristic, the lowest top, ties to the narrowest node
+	for (size_t i = 0; i < page->skyline_length; i++)
+	{
+		if (sFit(page, i, width, height, page_width, page_height, &y) == false)
+			continue;
+
+		if (y + height < best_top || (y + height == best_top && page->skyline[i].width < best_width))
+		{
+			best = i;
+			best_top = y + height;
+			best_width = page->skyline[i].width;
+		}
+	}
+
+	if (best == SIZE_MAX)
+		return 1;
+
+	// Insert a node for the rectangle top
+	if (page->skyline_length == page->skyline_capacity)
+	{
+		struct kaAtlasNode* temp = realloc(page->skyline, sizeof(struct kaAtlasNode) * page->skyline_capacity * 2);
+
+		if (temp == NULL)
+			return 2;
+
+		page->skyline = temp;
+		page->skyline_capacity *= 2;
+	}
+
+	*out_x = page->skyline[best].x;
+	*out_y = best_top - height;
+
+	memmove(&page->skyline[best + 1], &page->skyline[best],
+	        sizeof(struct kaAtlasNode) * (page->skyline_length - best));
+	page->skyline[best] = (struct kaAtlasNode){.x = *out_x, .y = best_top, .width = width};
+	page->skyline_length += 1;
+
+	// Shrink, or remove, nodes now below it
+	const size_t end = *out_x + width;
+
+	for (size_t i = best + 1; i < page->skyline_length;)
+	{
+		struct kaAtlasNode* node = &page->skyline[i];
+
+		if (node->x >= end)
+			break;
+
+		if (node->x + node->width <= end)
+		{
+			memmove(node, node + 1, sizeof(struct kaAtlasNode) * (page->skyline_length - i - 1));
+			page->skyline_length -= 1;
+			continue;
+		}
+
+		node->width -= end - node->x;
+		node->x = end;
+		break;
+	}
+
+	// Merge neighbours of the same height
+	for (size_t i = 0; i + 1 < page->skyline_length;)
+	{
+		if (page->skyline[i].y == page->skyline[i + 1].y)
+		{
+			page->skyline[i].width += page->skyline[i + 1].width;
+			memmove(&page->skyline[i + 1], &page->skyline[i + 2],
+			        sizeof(struct kaAtlasNode) * (page->skyline_length - i - 2));
+			page->skyline_length -= 1;
+			continue;
+		}
+
+		i++;
+	}
+
+	return 0;
+}
+
+
+static void sExtrude(const struct jaImage* image, size_t padding, uint8_t* out)
+{
+	// Converted to RGBA as GL does with luminance formats, borders
+	// repeated outwards so filters sample the image rather than a
+	// neighbour. Mipmaps stay clean while 'padding >> level' >= 1
+	const size_t width = image->width + padding * 2;
+	const size_t height = image->height + padding * 2;
+	const uint8_t* data = image->data;
+
+	for (size_t row = 0; row < height; row++)
+	{
+		const size_t y = (row < padding) ? 0 : (row - padding >= image->height) ? image->height - 1 : row - padding;
+
+		for (size_t col = 0; col < width; col++)
+		{
+			const size_t x = (col < padding) ? 0 : (col - padding >= image->width) ? image->width - 1 : col - padding;
+			const uint8_t* src = data + (image->width * y + x) * image->channels;
+
+			switch (image->channels)
+			{
+			case 1: out[0] = src[0], out[1] = src[0], out[2] = src[0], out[3] = 255; break;
+			case 2: out[0] = src[0], out[1] = src[0], out[2] = src[0], out[3] = src[1]; break;
+			case 3: out[0] = src[0], out[1] = src[1], out[2] = src[2], out[3] = 255; break;
+			default: out[0] = src[0], out[1] = src[1], out[2] = src[2], out[3] = src[3]; break;
+			}
+
+			out += 4;
+		}
+	}
+}
+
+
+int kaAtlasInit(struct kaWindow* window, size_t width, size_t height, size_t padding, enum kaTextureFilter filter,
+                struct kaAtlas* out, struct jaStatus* st)
+{
+	(void)window;
+	jaStatusSet(st, "kaAtlasInit", JA_STATUS_SUCCESS, NULL);
+
+	if (width == 0 || height == 0)
+	{
+		jaStatusSet(st, "kaAtlasInit", JA_STATUS_INVALID_ARGUMENT, NULL);
+		return 1;
+	}
+
+	memset(out, 0, sizeof(struct kaAtlas));
+	out->width = width;
+	out->height = height;
+	out->padding = padding;
+	out->filter = filter;
+
+	// Pages created on demand
+	return 0;
+}
+
+
+void kaAtlasFree(struct kaWindow* window, struct kaAtlas* atlas)
+{
+	if (atlas->pages == NULL)
+		return;
+
+	for (size_t i = 0; i < atlas->pages_length; i++)
+	{
+		kaTextureFree(window, &atlas->pages[i]->texture);
+		free(atlas->pages[i]->skyline);
+		free(atlas->pages[i]);
+	}
+
+	free(atlas->pages);
+	atlas->pages = NULL;
+	atlas->pages_length = 0;
+}
+
+
+int kaAtlasAdd(struct kaWindow* window, struct kaAtlas* atlas, const struct jaImage* image, struct kaAtlasSprite* out,
+               struct jaStatus* st)
+{
+	const size_t width = image->width + atlas->padding * 2;
+	const size_t height = image->height + atlas->padding * 2;
+
+	struct kaAtlasPage* page = NULL;
+	uint8_t* temp = NULL;
+	size_t x = 0;
+	size_t y = 0;
+	int ret = 1;
+
+	jaStatusSet(st, "kaAtlasAdd", JA_STATUS_SUCCESS, NULL);
+
+	if (image->format != JA_IMAGE_U8 || image->channels == 0 || image->channels > 4)
+	{
+		jaStatusSet(st, "kaAtlasAdd", JA_STATUS_ERROR, "only 8 bits per component images supported");
+		return 1;
+	}
+
+	if (image->width == 0 || image->height == 0 || width > atlas->width || height > atlas->height)
+	{
+		jaStatusSet(st, "kaAtlasAdd", JA_STATUS_INVALID_ARGUMENT, "image larger than atlas");
+		return 1;
+	}
+
+	// Find a page with space, the last ones are the emptiest
+	for (size_t i = atlas->pages_length; i > 0; i--)
+	{
+		if ((ret = sPlace(atlas->pages[i - 1], width, height, atlas->width, atlas->height, &x, &y)) != 1)
+		{
+			page = atlas->pages[i - 1];
+			break;
+		}
+	}
+
+	if (ret == 1)
+	{
+		if (sNewPage(window, atlas, st) != 0)
+			return 1;
+
+		page = atlas->pages[atlas->pages_length - 1];
+		ret = sPlace(page, width, height, atlas->width, atlas->height, &x, &y);
+	}
+
+	if (ret != 0 || (temp = malloc(width * height * 4)) == NULL)
+	{
+		jaStatusSet(st, "kaAtlasAdd", JA_STATUS_MEMORY_ERROR, NULL);
+		return 1;
+	}
+
+	// Upload
+	GLuint old_bind = window->shadow.texture[window->shadow.active_unit];
+
+	sExtrude(image, atlas->padding, temp);
+	InternalBindTexture(window, window->shadow.active_unit, page->texture.glptr);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, (GLint)x, (GLint)y, (GLsizei)width, (GLsizei)height, GL_RGBA, GL_UNSIGNED_BYTE,
+	                temp);
+	InternalBindTexture(window, window->shadow.active_unit, old_bind);
+
+	free(temp);
+	page->dirty = true;
+
+	// Bye!
+	out->texture = &page->texture;
+	out->uv.min.x = (float)(x + atlas->padding) / (float)atlas->width;
+	out->uv.min.y = (float)(y + atlas->padding) / (float)atlas->height;
+	out->uv.max.x = (float)(x + atlas->padding + image->width) / (float)atlas->width;
+	out->uv.max.y = (float)(y + atlas->padding + image->height) / (float)atlas->height;
+
+	return 0;
+}
+
+
+void kaAtlasCommit(struct kaWindow* window, struct kaAtlas* atlas)
+{
+	GLuint old_bind = window->shadow.texture[window->shadow.active_unit];
+
+	for (size_t i = 0; i < atlas->pages_length; i++)
+	{
+		if (atlas->pages[i]->dirty == false)
+			continue;
+
+		if (atlas->filter != KA_FILTER_NONE)
+		{
+			InternalBindTexture(window, window->shadow.active_unit, atlas->pages[i]->texture.glptr);
+			glGenerateMipmap(GL_TEXTURE_2D);
+		}
+
+		atlas->pages[i]->dirty = false;
+	}
+
+	InternalBindTexture(window, window->shadow.active_unit, old_bind);
+}
@@ -0,0 +1,195 @@
+/*-----------------------------
+
+MIT License
+
+Copyright (c) 2020 Alexander Brandt
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-------------------------------
+
+ [context/batch.c]
+ - Alexander Brandt 2020
+-----------------------------*/
+
+#include "private.h"
+
+
+#define MAX_QUADS (UINT16_MAX / 4) // Index is 16 bits
+
+
+int kaBatchInit(struct kaWindow* window, size_t max_quads, struct kaBatch* out, struct jaStatus* st)
+{
+	uint16_t* raw_index = NULL;
+
+	jaStatusSet(st, "kaBatchInit", JA_STATUS_SUCCESS, NULL);
+	memset(out, 0, sizeof(struct kaBatch));
+
+	if (max_quads == 0)
+	{
+		jaStatusSet(st, "kaBatchInit", JA_STATUS_INVALID_ARGUMENT, NULL);
+		return 1;
+	}
+
+	if (max_quads > MAX_QUADS)
+		max_quads = MAX_QUADS;
+
+	// Staging area, where quads are gathered before a flush
+	if ((out->staging = malloc(sizeof(struct kaVertex) * 4 * max_quads)) == NULL ||
+	    (raw_index = malloc(sizeof(uint16_t) * 6 * max_quads)) == NULL)
+	{
+		jaStatusSet(st, "kaBatchInit", JA_STATUS_MEMORY_ERROR, NULL);
+		goto return_failure;
+	}
+
+	// An index shared by all quads, same winding as the default one
+	for (size_t i = 0; i < max_quads; i++)
+	{
+		raw_index[i * 6 + 0] = (uint16_t)(i * 4 + 2);
+		raw_index[i * 6 + 1] = (uint16_t)(i * 4 + 1);
+		raw_index[i * 6 + 2] = (uint16_t)(i * 4 + 0);
+		raw_index[i * 6 + 3] = (uint16_t)(i * 4 + 3);
+		raw_index[i * 6 + 4] = (uint16_t)(i * 4 + 2);
+		raw_index[i * 6 + 5] = (uint16_t)(i * 4 + 0);
+	}
+
+	if (kaIndexInit(window, raw_index, 6 * max_quads, &out->index, st) != 0 ||
+	    kaVerticesInit(window, NULL, (uint16_t)(4 * max_quads), &out->vertices, st) != 0)
+		goto return_failure;
+
+	out->max_length = max_quads;
+
+	// Bye!
+	free(raw_index);
+	return 0;
+
+return_failure:
+	if (raw_index != NULL)
+		free(raw_index);
+
+	kaBatchFree(window, out);
+	return 1;
+}
+
+
+void kaBatchFree(struct kaWindow* window, struct kaBatch* batch)
+{
+	if (batch == NULL)
+		return;
+
+	if (window != NULL && window->pending_batch == batch)
+		window->pending_batch = NULL;
+
+	kaVerticesFree(window, &batch->vertices);
+	kaIndexFree(window, &batch->index);
+
+	if (batch->staging != NULL)
+		free(batch->staging);
+
+	batch->staging = NULL;
+	batch->length = 0;
+	batch->max_length = 0;
+}
+
+
+static inline struct jaVectorF3 sTransform(const struct jaMatrixF4* m, float x, float y)
+{
+	// Quads lie in the z = 0 plane, and the matrix is assumed to be affine
+	return (struct jaVectorF3){m->e[0][0] * x + m->e[1][0] * y + m->e[3][0],
+	                           m->e[0][1] * x + m->e[1][1] * y + m->e[3][1],
+	                           m->e[0][2] * x + m->e[1][2] * y + m->e[3][2]};
+}
+
+
+void kaBatchQuad(struct kaWindow* window, struct kaBatch* batch, const struct kaTexture* texture,
+                 struct jaMatrixF4 local, struct kaAABRectangle uv, struct kaRgba tint)
+{
+	struct kaVertex* v = NULL;
+
+	if (window == NULL || batch == NULL || batch->staging == NULL)
+		return;
+
+	if (texture == NULL)
+		texture = &window->default_texture;
+
+	// Changes in state means that previous quads need to be drawn first
+	if (window->pending_batch != NULL && window->pending_batch != batch)
+		InternalBatchFlush(window);
+
+	if (batch->length != 0 && (batch->texture != texture || batch->program != window->current_program ||
+	                           batch->length == batch->max_length))
+		kaBatchFlush(window, batch);
+
+	batch->texture = texture;
+	batch->program = window->current_program;
+	window->pending_batch = batch;
+
+	// Stage it, same layout as the default quad
+	v = batch->staging + batch->length * 4;
+	batch->length += 1;
+
+	v[0] = (struct kaVertex){sTransform(&local, -0.5f, -0.5f), tint, {uv.min.x, uv.max.y}};
+	v[1] = (struct kaVertex){sTransform(&local, -0.5f, +0.5f), tint, {uv.min.x, uv.min.y}};
+	v[2] = (struct kaVertex){sTransform(&local, +0.5f, +0.5f), tint, {uv.max.x, uv.min.y}};
+	v[3] = (struct kaVertex){sTransform(&local, +0.5f, -0.5f), tint, {uv.max.x, uv.max.y}};
+}
+
+
+void kaBatchFlush(struct kaWindow* window, struct kaBatch* batch)
+{
+	struct CallerState old;
+
+	if (window == NULL || batch == NULL)
+		return;
+
+	if (window->pending_batch == batch)
+		window->pending_batch = NULL; // Before any kaSet*(), they flush too
+
+	if (batch->length == 0)
+		return;
+
+	InternalSaveState(window, &old);
+
+	kaSetProgram(window, batch->program);
+	kaSetTexture(window, 0, batch->texture);
+	kaSetVertices(window, &batch->vertices);
+	kaSetLocal(window, jaMatrixF4Identity()); // Quads are already transformed
+
+	// Orphan the previous storage, so we don't wait for draws still using it
+	InternalBindBuffer(window, GL_ARRAY_BUFFER, batch->vertices.glptr);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(sizeof(struct kaVertex) * 4 * batch->max_length), NULL,
+	             GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)(sizeof(struct kaVertex) * 4 * batch->length), batch->staging);
+
+	InternalBindBuffer(window, GL_ELEMENT_ARRAY_BUFFER, batch->index.glptr);
+	InternalDirtyFlush(window);
+	InternalUploadUniforms(window);
+	glDrawElements(GL_TRIANGLES, (GLsizei)(batch->length * 6), GL_UNSIGNED_SHORT, NULL);
+	window->stats.draws += 1;
+
+	batch->length = 0;
+	InternalRestoreState(window, &old);
+}
+
+
+inline void InternalBatchFlush(struct kaWindow* window)
+{
+	if (window->pending_batch != NULL)
+		kaBatchFlush(window, window->pending_batch);
+}
@@ -0,0 +1,371 @@
+/*-----------------------------
+
+MIT License
+
+Copyright (c) 2020 Alexander Brandt
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-------------------------------
+
+ [context/commands.c]
+ - Alexander Brandt 2020
+-----------------------------*/
+
+#include "private.h"
+
+
+#define MIN_CAPACITY 256
+
+enum Opcode
+{
+	SET_PROGRAM,
+	SET_VERTICES,
+	SET_TEXTURE,
+	SET_WORLD,
+	SET_LOCAL,
+	DRAW,
+	DRAW_DEFAULT
+};
+
+
+static uint8_t* sAppend(struct kaCommandBuffer* cb, enum Opcode op, size_t payload_size)
+{
+	uint8_t* cmd = NULL;
+
+	if (cb->length + 1 + payload_size > cb->capacity)
+	{
+		size_t capacity = (cb->capacity == 0) ? MIN_CAPACITY : cb->capacity;
+		void* data = NULL;
+
+		while (cb->length + 1 + payload_size > capacity)
+			capacity *= 2;
+
+		if ((data = realloc(cb->data, capacity)) == NULL)
+			return NULL;
+
+		cb->data = data;
+		cb->capacity = capacity;
+	}
+
+	cmd = cb->data + cb->length;
+	cmd[0] = (uint8_t)op;
+	cb->length += 1 + payload_size;
+
+	return cmd + 1; // Payload
+}
+
+
+static int sMatrix(struct kaCommandBuffer* cb, enum Opcode op, struct jaMatrixF4* last, bool* has_last,
+                   size_t* pending, struct jaMatrixF4 matrix)
+{
+	uint8_t* payload = NULL;
+
+	if (*has_last == true && memcmp(last, &matrix, sizeof(struct jaMatrixF4)) == 0)
+		return 0;
+
+	// A previous matrix that no draw used, overwrite it
+	if (*pending != 0)
+		payload = cb->data + *pending;
+	else
+	{
+		if ((payload = sAppend(cb, op, sizeof(struct jaMatrixF4))) == NULL)
+			return 1;
+
+		*pending = (size_t)(payload - cb->data);
+	}
+
+	memcpy(payload, &matrix, sizeof(struct jaMatrixF4));
+	*last = matrix;
+	*has_last = true;
+	return 0;
+}
+
+
+static inline int sPointer(struct kaCommandBuffer* cb, enum Opcode op, const void* ptr)
+{
+	uint8_t* payload = NULL;
+
+	if ((payload = sAppend(cb, op, sizeof(void*))) == NULL)
+		return 1;
+
+	memcpy(payload, &ptr, sizeof(void*));
+	return 0;
+}
+
+
+int kaCommandSetProgram(struct kaCommandBuffer* cb, const struct kaProgram* program)
+{
+	if (cb == NULL || program == NULL || program == cb->program)
+		return 0;
+
+	if (sPointer(cb, SET_PROGRAM, program) != 0)
+		return 1;
+
+	cb->program = program;
+	return 0;
+}
+
+
+int kaCommandSetVertices(struct kaCommandBuffer* cb, const struct kaVertices* vertices)
+{
+	if (cb == NULL || vertices == NULL || vertices == cb->vertices)
+		return 0;
+
+	if (sPointer(cb, SET_VERTICES, vertices) != 0)
+		return 1;
+
+	cb->vertices = vertices;
+	return 0;
+}
+
+
+int kaCommandSetTexture(struct kaCommandBuffer* cb, int unit, const struct kaTexture* texture)
+{
+	uint8_t* payload = NULL;
+
+	if (cb == NULL || texture == NULL || unit < 0 || unit >= MAX_TEXTURE_UNITS || texture == cb->texture[unit])
+		return 0;
+
+	if ((payload = sAppend(cb, SET_TEXTURE, 1 + sizeof(void*))) == NULL)
+		return 1;
+
+	payload[0] = (uint8_t)unit;
+	memcpy(payload + 1, &texture, sizeof(void*));
+
+	cb->texture[unit] = texture;
+	return 0;
+}
+
+
+inline int kaCommandSetWorld(struct kaCommandBuffer* cb, struct jaMatrixF4 matrix)
+{
+	if (cb == NULL)
+		return 0;
+
+	return sMatrix(cb, SET_WORLD, &cb->world, &cb->has_world, &cb->pending_world, matrix);
+}
+
+
+inline int kaCommandSetLocal(struct kaCommandBuffer* cb, struct jaMatrixF4 matrix)
+{
+	if (cb == NULL)
+		return 0;
+
+	return sMatrix(cb, SET_LOCAL, &cb->local, &cb->has_local, &cb->pending_local, matrix);
+}
+
+
+int kaCommandDraw(struct kaCommandBuffer* cb, const struct kaIndex* index)
+{
+	if (cb == NULL || index == NULL)
+		return 0;
+
+	if (sPointer(cb, DRAW, index) != 0)
+		return 1;
+
+	cb->pending_world = 0;
+	cb->pending_local = 0;
+	return 0;
+}
+
+
+int kaCommandDrawDefault(struct kaCommandBuffer* cb)
+{
+	if (cb == NULL)
+		return 0;
+
+	if (sAppend(cb, DRAW_DEFAULT, 0) == NULL)
+		return 1;
+
+	cb->pending_world = 0;
+	cb->pending_local = 0;
+	return 0;
+}
+
+
+void kaCommandBufferClear(struct kaCommandBuffer* cb)
+{
+	uint8_t* data = cb->data;
+	size_t capacity = cb->capacity;
+
+	memset(cb, 0, sizeof(struct kaCommandBuffer));
+	cb->data = data;
+	cb->capacity = capacity;
+}
+
+
+void kaCommandBufferFree(struct kaCommandBuffer* cb)
+{
+	if (cb->data != NULL)
+		free(cb->data);
+
+	memset(cb, 0, sizeof(struct kaCommandBuffer));
+}
+
+
+void kaCommandBufferSubmit(struct kaWindow* window, const struct kaCommandBuffer* cb)
+{
+	struct jaMatrixF4 matrix;
+	const void* ptr = NULL;
+
+	if (window == NULL || cb == NULL)
+		return;
+
+	// Commands were validated while recorded
+	for (const uint8_t* cmd = cb->data; cmd < cb->data + cb->length;)
+	{
+		switch ((enum Opcode)cmd[0])
+		{
+		case SET_PROGRAM:
+			memcpy(&ptr, cmd + 1, sizeof(void*));
+			kaSetProgram(window, ptr);
+			cmd += 1 + sizeof(void*);
+			break;
+		case SET_VERTICES:
+			memcpy(&ptr, cmd + 1, sizeof(void*));
+			kaSetVertices(window, ptr);
+			cmd += 1 + sizeof(void*);
+			break;
+		case SET_TEXTURE:
+			memcpy(&ptr, cmd + 2, sizeof(void*));
+			kaSetTexture(window, cmd[1], ptr);
+			cmd += 2 + sizeof(void*);
+			break;
+		case SET_WORLD:
+			memcpy(&matrix, cmd + 1, sizeof(struct jaMatrixF4));
+			kaSetWorld(window, matrix);
+			cmd += 1 + sizeof(struct jaMatrixF4);
+			break;
+		case SET_LOCAL:
+			memcpy(&matrix, cmd + 1, sizeof(struct jaMatrixF4));
+			kaSetLocal(window, matrix);
+			cmd += 1 + sizeof(struct jaMatrixF4);
+			break;
+		case DRAW:
+			memcpy(&ptr, cmd + 1, sizeof(void*));
+			kaDraw(window, ptr);
+			cmd += 1 + sizeof(void*);
+			break;
+		case DRAW_DEFAULT:
+			kaDrawDefault(window);
+			cmd += 1;
+			break;
+		default: return; // Corrupted
+		}
+	}
+}
+
+
+int kaCommandBufferEnqueue(struct kaWindow* window, const struct kaCommandBuffer* cb, int order, struct jaStatus* st)
+{
+	int ret = 0;
+
+	jaStatusSet(st, "kaCommandBufferEnqueue", JA_STATUS_SUCCESS, NULL);
+
+	if (window == NULL || cb == NULL)
+		return 0;
+
+	SDL_LockMutex(window->commands.mutex);
+
+	// Threads reach the mutex in any order, so that can't break ties
+	for (size_t i = 0; i < window->commands.length; i++)
+	{
+		if (window->commands.lists[i].order == order)
+		{
+			jaStatusSet(st, "kaCommandBufferEnqueue", JA_STATUS_INVALID_ARGUMENT, "order already enqueued");
+			ret = 1;
+			goto bye;
+		}
+	}
+
+	if (window->commands.length == window->commands.capacity)
+	{
+		size_t capacity = (window->commands.capacity == 0) ? 16 : window->commands.capacity * 2;
+		struct CommandList* lists = realloc(window->commands.lists, sizeof(struct CommandList) * capacity);
+
+		if (lists == NULL)
+		{
+			jaStatusSet(st, "kaCommandBufferEnqueue", JA_STATUS_MEMORY_ERROR, NULL);
+			ret = 1;
+			goto bye;
+		}
+
+		window->commands.lists = lists;
+		window->commands.capacity = capacity;
+	}
+
+	window->commands.lists[window->commands.length].cb = cb;
+	window->commands.lists[window->commands.length].order = order;
+	window->commands.length += 1;
+
+bye:
+	SDL_UnlockMutex(window->commands.mutex);
+	return ret;
+}
+
+
+static int sCompare(const void* a, const void* b)
+{
+	const struct CommandList* la = a;
+	const struct CommandList* lb = b;
+
+	return (la->order < lb->order) ? -1 : (la->order > lb->order) ? 1 : 0; // Unique
+}
+
+
+int InternalCommandsInit(struct kaWindow* window)
+{
+	memset(&window->commands, 0, sizeof(window->commands));
+
+	if ((window->commands.mutex = SDL_CreateMutex()) == NULL)
+		return 1;
+
+	return 0;
+}
+
+
+void InternalCommandsFlush(struct kaWindow* window)
+{
+	if (window->commands.mutex == NULL)
+		return;
+
+	// Workers enqueuing meanwhile will wait, and those lists go into the next frame
+	SDL_LockMutex(window->commands.mutex);
+
+	qsort(window->commands.lists, window->commands.length, sizeof(struct CommandList), sCompare);
+
+	for (size_t i = 0; i < window->commands.length; i++)
+		kaCommandBufferSubmit(window, window->commands.lists[i].cb);
+
+	window->commands.length = 0;
+	SDL_UnlockMutex(window->commands.mutex);
+}
+
+
+void InternalCommandsFree(struct kaWindow* window)
+{
+	if (window->commands.lists != NULL)
+		free(window->commands.lists);
+
+	if (window->commands.mutex != NULL)
+		SDL_DestroyMutex(window->commands.mutex);
+
+	memset(&window->commands, 0, sizeof(window->commands));
+}
@@ -0,0 +1,537 @@
+/*-----------------------------
+
+MIT License
+
+Copyright (c) 2020 Alexander Brandt
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-------------------------------
+
+ [context/compressed.c]
+ - Alexander Brandt 2020
+-----------------------------*/
+
+#include "private.h"
+#include <stdio.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COMPRESSED_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define COMPRESSED_NEON
+#include <arm_neon.h>
+#endif
+
+// Not in GLES2 headers
+#define FORMAT_ETC1_RGB8 0x8D64
+#define FORMAT_ETC2_RGB8 0x9274
+#define FORMAT_ETC2_RGBA8 0x9278
+#define FORMAT_S3TC_DXT1_RGB 0x83F0
+#define FORMAT_S3TC_DXT1_RGBA 0x83F1
+#define FORMAT_S3TC_DXT3 0x83F2
+#define FORMAT_S3TC_DXT5 0x83F3
+#define FORMAT_BPTC_RGBA 0x8E8C
+#define FORMAT_BPTC_SRGBA 0x8E8D
+
+#define KTX_HEADER_SIZE 64
+#define KTX_ENDIANNESS 0x04030201
+
+static const uint8_t s_ktx_identifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31,
+                                             0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+static const int s_etc1_modifiers[8][4] = {{2, 8, -2, -8},       {5, 17, -5, -17},     {9, 29, -9, -29},
+                                           {13, 42, -13, -42},   {18, 60, -18, -60},   {24, 80, -24, -80},
+                                           {33, 106, -33, -106}, {47, 183, -47, -183}};
+
+
+static inline uint8_t sClamp8(int v)
+{
+	return (uint8_t)((v < 0) ? 0 : (v > 255) ? 255 : v);
+}
+
+
+static void sEtc1Decode(const uint8_t* block, uint8_t* out) // To 16 RGBA pixels, row major
+{
+	const uint32_t hi = ((uint32_t)block[0] << 24) | ((uint32_t)block[1] << 16) | ((uint32_t)block[2] << 8) | block[3];
+	const uint32_t lo = ((uint32_t)block[4] << 24) | ((uint32_t)block[5] << 16) | ((uint32_t)block[6] << 8) | block[7];
+
+	int base[2][3];
+
+	if ((hi & 0x02) != 0) // Differential mode, 5 bits plus a signed 3 bits delta
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			const int v = (int)((hi >> (27 - c * 8)) & 0x1F);
+			const int d = (int)((hi >> (24 - c * 8)) & 0x07);
+			const int v2 = v + ((d >= 4) ? d - 8 : d);
+
+			base[0][c] = (v << 3) | (v >> 2);
+			base[1][c] = ((v2 & 0x1F) << 3) | ((v2 & 0x1F) >> 2);
+		}
+	}
+	else // Individual mode, two 4 bits colors
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			base[0][c] = (int)((hi >> (28 - c * 8)) & 0x0F) * 17;
+			base[1][c] = (int)((hi >> (24 - c * 8)) & 0x0F) * 17;
+		}
+	}
+
+	const int table[2] = {(int)((hi >> 5) & 0x07), (int)((hi >> 2) & 0x07)};
+	const bool flip = ((hi & 0x01) != 0) ? true : false;
+
+	// Indices are column major, most significant bits in the upper half
+	for (int x = 0; x < 4; x++)
+	{
+		for (int y = 0; y < 4; y++)
+		{
+			const int i = x * 4 + y;
+			const int sub = (flip == true) ? (y >= 2) : (x >= 2);
+			const int index = (int)(((lo >> (i + 16)) & 0x01) << 1 | ((lo >> i) & 0x01));
+			const int m = s_etc1_modifiers[table[sub]][index];
+
+			uint8_t* px = out + (y * 4 + x) * 4;
+			px[0] = sClamp8(base[sub][0] + m);
+			px[1] = sClamp8(base[sub][1] + m);
+			px[2] = sClamp8(base[sub][2] + m);
+			px[3] = 255;
+		}
+	}
+}
+
+
+#if defined(COMPRESSED_SSE2)
+static void sBounds(const uint8_t* pixels, uint8_t* out_min, uint8_t* out_max)
+{
+	const __m128i a = _mm_loadu_si128((const __m128i*)pixels);
+	const __m128i b = _mm_loadu_si128((const __m128i*)(pixels + 16));
+	const __m128i c = _mm_loadu_si128((const __m128i*)(pixels + 32));
+	const __m128i d = _mm_loadu_si128((const __m128i*)(pixels + 48));
+
+	__m128i min = _mm_min_epu8(_mm_min_epu8(a, b), _mm_min_epu8(c, d));
+	__m128i max = _mm_max_epu8(_mm_max_epu8(a, b), _mm_max_epu8(c, d));
+
+	min = _mm_min_epu8(min, _mm_srli_si128(min, 8));
+	min = _mm_min_epu8(min, _mm_srli_si128(min, 4));
+	max = _mm_max_epu8(max, _mm_srli_si128(max, 8));
+	max = _mm_max_epu8(max, _mm_srli_si128(max, 4));
+
+	const int32_t mn = _mm_cvtsi128_si32(min);
+	const int32_t mx = _mm_cvtsi128_si32(max);
+	memcpy(out_min, &mn, 4);
+	memcpy(out_max, &mx, 4);
+}
+
+static void sProject(const uint8_t* pixels, const uint8_t* min, const int16_t* axis, int32_t* out)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i origin = _mm_setr_epi16(min[0], min[1], min[2], 0, min[0], min[1], min[2], 0);
+	const __m128i dir = _mm_setr_epi16(axis[0], axis[1], axis[2], 0, axis[0], axis[1], axis[2], 0);
+	int32_t temp[4];
+
+	for (int i = 0; i < 4; i++)
+	{
+		const __m128i p = _mm_loadu_si128((const __m128i*)(pixels + i * 16));
+		__m128i l = _mm_madd_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(p, zero), origin), dir);
+		__m128i h = _mm_madd_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(p, zero), origin), dir);
+
+		// Pairs sum, dots end in lanes 0 and 2
+		l = _mm_add_epi32(l, _mm_shuffle_epi32(l, _MM_SHUFFLE(2, 3, 0, 1)));
+		h = _mm_add_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(2, 3, 0, 1)));
+
+		_mm_storeu_si128((__m128i*)temp, _mm_unpacklo_epi64(_mm_shuffle_epi32(l, _MM_SHUFFLE(3, 1, 2, 0)),
+		                                                     _mm_shuffle_epi32(h, _MM_SHUFFLE(3, 1, 2, 0))));
+		memcpy(out + i * 4, temp, sizeof(temp));
+	}
+}
+
+#elif defined(COMPRESSED_NEON)
+static void sBounds(const uint8_t* pixels, uint8_t* out_min, uint8_t* out_max)
+{
+	const uint8x16_t a = vld1q_u8(pixels);
+	const uint8x16_t b = vld1q_u8(pixels + 16);
+	const uint8x16_t c = vld1q_u8(pixels + 32);
+	const uint8x16_t d = vld1q_u8(pixels + 48);
+
+	const uint8x16_t min = vminq_u8(vminq_u8(a, b), vminq_u8(c, d));
+	const uint8x16_t max = vmaxq_u8(vmaxq_u8(a, b), vmaxq_u8(c, d));
+
+	uint8x8_t min8 = vmin_u8(vget_low_u8(min), vget_high_u8(min));
+	uint8x8_t max8 = vmax_u8(vget_low_u8(max), vget_high_u8(max));
+	min8 = vmin_u8(min8, vext_u8(min8, min8, 4));
+	max8 = vmax_u8(max8, vext_u8(max8, max8, 4));
+
+	uint8_t temp[8];
+	vst1_u8(temp, min8);
+	memcpy(out_min, temp, 4);
+	vst1_u8(temp, max8);
+	memcpy(out_max, temp, 4);
+}
+
+static void sProject(const uint8_t* pixels, const uint8_t* min, const int16_t* axis, int32_t* out)
+{
+	const int16_t o[4] = {min[0], min[1], min[2], 0};
+	const int16_t a[4] = {axis[0], axis[1], axis[2], 0};
+	const int16x4_t origin = vld1_s16(o);
+	const int16x4_t dir = vld1_s16(a);
+
+	for (int i = 0; i < 16; i += 2)
+	{
+		const int16x8_t p = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(pixels + i * 4)));
+		const int32x4_t l = vmull_s16(vsub_s16(vget_low_s16(p), origin), dir);
+		const int32x4_t h = vmull_s16(vsub_s16(vget_high_s16(p), origin), dir);
+		const int32x2_t s = vpadd_s32(vpadd_s32(vget_low_s32(l), vget_high_s32(l)),
+		                              vpadd_s32(vget_low_s32(h), vget_high_s32(h)));
+		vst1_s32(out + i, s);
+	}
+}
+
+#else
+static void sBounds(const uint8_t* pixels, uint8_t* out_min, uint8_t* out_max)
+{
+	memcpy(out_min, pixels, 4);
+	memcpy(out_max, pixels, 4);
+
+	for (int i = 1; i < 16; i++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			out_min[c] = (pixels[i * 4 + c] < out_min[c]) ? pixels[i * 4 + c] : out_min[c];
+			out_max[c] = (pixels[i * 4 + c] > out_max[c]) ? pixels[i * 4 + c] : out_max[c];
+		}
+	}
+}
+
+static void sProject(const uint8_t* pixels, const uint8_t* min, const int16_t* axis, int32_t* out)
+{
+	for (int i = 0; i < 16; i++)
+		out[i] = (pixels[i * 4 + 0] - min[0]) * axis[0] + (pixels[i * 4 + 1] - min[1]) * axis[1] +
+		         (pixels[i * 4 + 2] - min[2]) * axis[2];
+}
+#endif
+
+
+static inline uint16_t sTo565(const uint8_t* c)
+{
+	return (uint16_t)(((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3));
+}
+
+
+static void sDxt1Encode(const uint8_t* pixels, uint8_t* out) // From 16 RGBA pixels, row major
+{
+	// Endpoints at the bounding box corners, pixels projected
+	// into the diagonal. Not the best quality, but fast
+	uint8_t min[4];
+	uint8_t max[4];
+	int32_t dot[16];
+	uint32_t indices = 0;
+
+	sBounds(pixels, min, max);
+
+	const uint16_t c0 = sTo565(max);
+	const uint16_t c1 = sTo565(min);
+
+	if (c0 != c1) // Otherwise all indices to zero, c0
+	{
+		const int16_t axis[3] = {(int16_t)(max[0] - min[0]), (int16_t)(max[1] - min[1]), (int16_t)(max[2] - min[2])};
+		const int32_t length = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+
+		// From min to max: c1, 2/3 c1 + 1/3 c0, 1/3 c1 + 2/3 c0, c0
+		static const uint32_t remap[4] = {1, 3, 2, 0};
+
+		sProject(pixels, min, axis, dot);
+
+		for (int i = 0; i < 16; i++)
+		{
+			int32_t step = (length != 0) ? (dot[i] * 3 + length / 2) / length : 0;
+			step = (step < 0) ? 0 : (step > 3) ? 3 : step;
+			indices |= remap[step] << (i * 2);
+		}
+	}
+
+	out[0] = (uint8_t)(c0 & 0xFF);
+	out[1] = (uint8_t)(c0 >> 8);
+	out[2] = (uint8_t)(c1 & 0xFF);
+	out[3] = (uint8_t)(c1 >> 8);
+	out[4] = (uint8_t)(indices & 0xFF);
+	out[5] = (uint8_t)((indices >> 8) & 0xFF);
+	out[6] = (uint8_t)((indices >> 16) & 0xFF);
+	out[7] = (uint8_t)(indices >> 24);
+}
+
+
+static void sEtc1ToDxt1(const uint8_t* data, size_t blocks, uint8_t* out)
+{
+	uint8_t pixels[64];
+
+	for (size_t i = 0; i < blocks; i++)
+	{
+		sEtc1Decode(data + i * 8, pixels);
+		sDxt1Encode(pixels, out + i * 8);
+	}
+}
+
+
+static void sEtc1ToRgba(const uint8_t* data, size_t width, size_t height, uint8_t* out)
+{
+	uint8_t pixels[64];
+	const size_t blocks_x = (width + 3) / 4;
+	const size_t blocks_y = (height + 3) / 4;
+
+	for (size_t by = 0; by < blocks_y; by++)
+	{
+		for (size_t bx = 0; bx < blocks_x; bx++)
+		{
+			sEtc1Decode(data + (by * blocks_x + bx) * 8, pixels);
+
+			// Cropping blocks outside the image
+			for (size_t y = 0; y < 4 && by * 4 + y < height; y++)
+			{
+				for (size_t x = 0; x < 4 && bx * 4 + x < width; x++)
+					memcpy(out + ((by * 4 + y) * width + bx * 4 + x) * 4, pixels + (y * 4 + x) * 4, 4);
+			}
+		}
+	}
+}
+
+
+static inline uint32_t sRead32(const uint8_t* data, bool swap)
+{
+	uint32_t v = 0;
+	memcpy(&v, data, sizeof(uint32_t));
+
+	if (swap == true)
+		v = ((v & 0xFF) << 24) | ((v & 0xFF00) << 8) | ((v >> 8) & 0xFF00) | (v >> 24);
+
+	return v;
+}
+
+
+static size_t sBlockSize(uint32_t format)
+{
+	switch (format)
+	{
+	case FORMAT_ETC1_RGB8:
+	case FORMAT_ETC2_RGB8:
+	case FORMAT_S3TC_DXT1_RGB:
+	case FORMAT_S3TC_DXT1_RGBA: return 8;
+	case FORMAT_ETC2_RGBA8:
+	case FORMAT_S3TC_DXT3:
+	case FORMAT_S3TC_DXT5:
+	case FORMAT_BPTC_RGBA:
+	case FORMAT_BPTC_SRGBA: return 16;
+	default: return 0;
+	}
+}
+
+
+static bool sSupported(const struct kaWindow* window, uint32_t format)
+{
+	switch (format)
+	{
+	case FORMAT_ETC1_RGB8: return window->ext.etc1;
+	case FORMAT_ETC2_RGB8:
+	case FORMAT_ETC2_RGBA8: return window->ext.etc2;
+	case FORMAT_S3TC_DXT1_RGB:
+	case FORMAT_S3TC_DXT1_RGBA:
+	case FORMAT_S3TC_DXT3:
+	case FORMAT_S3TC_DXT5: return window->ext.s3tc;
+	case FORMAT_BPTC_RGBA:
+	case FORMAT_BPTC_SRGBA: return window->ext.bptc;
+	default: return false;
+	}
+}
+
+
+static int sUploadLevel(struct kaWindow* window, uint32_t format, GLint level, size_t width, size_t height,
+                        const uint8_t* data, size_t size, uint8_t** temp)
+{
+	// Native, or ETC2 that decodes ETC1 as is
+	if (sSupported(window, format) == true || (format == FORMAT_ETC1_RGB8 && window->ext.etc2 == true))
+	{
+		format = (sSupported(window, format) == true) ? format : FORMAT_ETC2_RGB8;
+		glCompressedTexImage2D(GL_TEXTURE_2D, level, format, (GLsizei)width, (GLsizei)height, 0, (GLsizei)size, data);
+		return 0;
+	}
+
+	// Transcode ETC1, as intermediate format
+	if (window->ext.s3tc == true)
+	{
+		if ((*temp = realloc(*temp, size)) == NULL)
+			return 1;
+
+		sEtc1ToDxt1(data, size / 8, *temp);
+		glCompressedTexImage2D(GL_TEXTURE_2D, level, FORMAT_S3TC_DXT1_RGB, (GLsizei)width, (GLsizei)height, 0,
+		                       (GLsizei)size, *temp);
+	}
+	else
+	{
+		if ((*temp = realloc(*temp, width * height * 4)) == NULL)
+			return 1;
+
+		sEtc1ToRgba(data, width, height, *temp);
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, (GLsizei)width, (GLsizei)height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+		             *temp);
+	}
+
+	return 0;
+}
+
+
+int kaTextureInitKtxMemory(struct kaWindow* window, const void* data, size_t size, enum kaTextureFilter filter,
+                           enum kaTextureWrap wrap, struct kaTexture* out, struct jaStatus* st)
+{
+	const uint8_t* bytes = data;
+	uint8_t* temp = NULL;
+	GLuint old_bind = window->shadow.texture[window->shadow.active_unit];
+
+	jaStatusSet(st, "kaTextureInitKtx", JA_STATUS_SUCCESS, NULL);
+	memset(out, 0, sizeof(struct kaTexture));
+
+	// Header
+	if (size < KTX_HEADER_SIZE || memcmp(bytes, s_ktx_identifier, sizeof(s_ktx_identifier)) != 0)
+	{
+		jaStatusSet(st, "kaTextureInitKtx", JA_STATUS_UNKNOWN_FILE_FORMAT, NULL);
+		return 1;
+	}
+
+	const bool swap = (sRead32(bytes + 12, false) != KTX_ENDIANNESS) ? true : false;
+	const uint32_t type = sRead32(bytes + 16, swap);
+	const uint32_t format = sRead32(bytes + 28, swap);
+	const uint32_t width = sRead32(bytes + 36, swap);
+	const uint32_t height = sRead32(bytes + 40, swap);
+	const uint32_t depth = sRead32(bytes + 44, swap);
+	const uint32_t array_elements = sRead32(bytes + 48, swap);
+	const uint32_t faces = sRead32(bytes + 52, swap);
+	const uint32_t levels = (sRead32(bytes + 56, swap) == 0) ? 1 : sRead32(bytes + 56, swap);
+	const uint32_t key_values = sRead32(bytes + 60, swap);
+
+	if (type != 0 || sBlockSize(format) == 0 || width == 0 || height == 0 || depth > 1 || array_elements != 0 ||
+	    faces != 1)
+	{
+		jaStatusSet(st, "kaTextureInitKtx", JA_STATUS_UNSUPPORTED_FEATURE, "only compressed 2d textures");
+		return 1;
+	}
+
+	if (sSupported(window, format) == false && format != FORMAT_ETC1_RGB8)
+	{
+		jaStatusSet(st, "kaTextureInitKtx", JA_STATUS_UNSUPPORTED_FEATURE, "compressed format");
+		return 1;
+	}
+
+	// Mipmaps only with the entire chain, GLES2 lacks GL_TEXTURE_MAX_LEVEL
+	uint32_t chain = 1;
+	for (uint32_t s = (width > height) ? width : height; s > 1; s >>= 1)
+		chain += 1;
+
+	glGenTextures(1, &out->glptr);
+	InternalBindTexture(window, window->shadow.active_unit, out->glptr);
+	InternalTextureParameters(filter, wrap, (levels >= chain) ? true : false);
+
+	out->filter = filter;
+	out->wrap = wrap;
+
+	// Levels
+	size_t cursor = KTX_HEADER_SIZE + key_values;
+
+	for (uint32_t l = 0; l < levels && l < chain; l++)
+	{
+		const size_t w = (width >> l > 0) ? width >> l : 1;
+		const size_t h = (height >> l > 0) ? height >> l : 1;
+		const size_t expected = ((w + 3) / 4) * ((h + 3) / 4) * sBlockSize(format);
+
+		if (cursor + 4 > size || sRead32(bytes + cursor, swap) != expected || cursor + 4 + expected > size)
+		{
+			jaStatusSet(st, "kaTextureInitKtx", JA_STATUS_ERROR, "truncated or malformed file");
+			goto return_failure;
+		}
+
+		if (sUploadLevel(window, format, (GLint)l, w, h, bytes + cursor + 4, expected, &temp) != 0)
+		{
+			jaStatusSet(st, "kaTextureInitKtx", JA_STATUS_MEMORY_ERROR, NULL);
+			goto return_failure;
+		}
+
+		cursor += 4 + ((expected + 3) & ~(size_t)3);
+	}
+
+	// Bye!
+	free(temp);
+	InternalBindTexture(window, window->shadow.active_unit, old_bind);
+	return 0;
+
+return_failure:
+	free(temp);
+	InternalBindTexture(window, window->shadow.active_unit, old_bind);
+	kaTextureFree(window, out);
+	return 1;
+}
+
+
+int kaTextureInitKtx(struct kaWindow* window, const char* filename, enum kaTextureFilter filter,
+                     enum kaTextureWrap wrap, struct kaTexture* out, struct jaStatus* st)
+{
+	FILE* fp = NULL;
+	uint8_t* data = NULL;
+	long size = 0;
+
+	jaStatusSet(st, "kaTextureInitKtx", JA_STATUS_SUCCESS, NULL);
+
+	if ((fp = fopen(filename, "rb")) == NULL)
+	{
+		jaStatusSet(st, "kaTextureInitKtx", JA_STATUS_IO_ERROR, filename);
+		return 1;
+	}
+
+	if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) <= 0 || fseek(fp, 0, SEEK_SET) != 0)
+	{
+		jaStatusSet(st, "kaTextureInitKtx", JA_STATUS_IO_ERROR, filename);
+		goto return_failure;
+	}
+
+	if ((data = malloc((size_t)size)) == NULL)
+	{
+		jaStatusSet(st, "kaTextureInitKtx", JA_STATUS_MEMORY_ERROR, NULL);
+		goto return_failure;
+	}
+
+	if (fread(data, (size_t)size, 1, fp) != 1)
+	{
+		jaStatusSet(st, "kaTextureInitKtx", JA_STATUS_IO_ERROR, filename);
+		goto return_failure;
+	}
+
+	fclose(fp);
+
+	if (kaTextureInitKtxMemory(window, data, (size_t)size, filter, wrap, out, st) != 0)
+	{
+		free(data);
+		return 1;
+	}
+
+	free(data);
+	return 0;
+
+return_failure:
+	free(data);
+	fclose(fp);
+	return 1;
+}
@@ -95,6 +95,16 @@ void InternalFreeWindow(struct kaWindow* window)
 		if (window->temp_image != NULL)
 			jaImageDelete(window->temp_image);
 
+		if (window->residency != NULL)
+			kaResidencyDelete(window, window->residency);
+
+		InternalLoaderFree(window);
+		InternalMipmapsFree(window);
+		InternalDirtyFree(window);
+
+		InternalQueueFree(window);
+		InternalCommandsFree(window);
+
 		kaProgramFree(window, &window->default_program);
 		kaVerticesFree(window, &window->default_vertices);
 		kaTextureFree(window, &window->default_texture);
@@ -163,6 +173,17 @@ int InternalInitGlad()
 }
 
 
+static void sCheckErrors()
+{
+	// Once per frame rather than once per call, as glGetError()
+	// is synchronous. Limited since a lost context loops forever
+	GLenum error = GL_NO_ERROR;
+
+	for (int i = 0; i < 8 && (error = glGetError()) != GL_NO_ERROR; i++) // HARDCODED
+		fprintf(stderr, "LibKansai: GL error 0x%04X on frame %zu\n", (unsigned)error, g_context.frame_no);
+}
+
+
 int kaContextStart(struct jaStatus* st)
 {
 	jaStatusSet(st, "kaContextStart", JA_STATUS_SUCCESS, NULL);
@@ -293,8 +314,21 @@ int kaContextUpdate(struct jaStatus* st)
 
 		if (g_context.focused_window == window || (g_context.frame_no % 4) == 0) // HARDCODED
 		{
+			kaRenderTargetUnbind(window); // Flushes what was queued for it
+			InternalBatchFlush(window);
+			InternalCommandsFlush(window);
+			InternalQueueFlush(window);
+			InternalDirtyFlush(window); // Marks that no draw used
+			InternalResidencyUpdate(window);
+
+			if (window->debug == true)
+				sCheckErrors();
+
 			SDL_GL_SwapWindow(window->sdl_window);
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			window->last_stats = window->stats;
+			memset(&window->stats, 0, sizeof(struct kaStatistics));
 		}
 
 		// Delete window / delete callback
@@ -325,6 +359,9 @@ int kaContextUpdate(struct jaStatus* st)
 			}
 		}
 
+		// Asynchronous loads, before the frame draws them
+		InternalLoaderFlush(window);
+
 		// Frame callback
 		if (window->frame_callback != NULL)
 		{
@@ -0,0 +1,296 @@
+/*-----------------------------
+
+MIT License
+
+Copyright (c) 2020 Alexander Brandt
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-------------------------------
+
+ [context/dirty.c]
+ - Alexander Brandt 2020
+-----------------------------*/
+
+#include "private.h"
+
+#define UNPACK_ROW_LENGTH 0x0CF2 // GLES3, or desktop
+#define MAX_RECTS 8              // Per texture, more merge anyway
+#define MIN_CAPACITY 8
+
+struct Rect
+{
+	size_t x0, y0; // Inclusive
+	size_t x1, y1; // Exclusive
+};
+
+struct DirtyTexture
+{
+	struct kaTexture* texture;
+	const struct jaImage* image;
+
+	struct Rect rect[MAX_RECTS];
+	size_t rects;
+};
+
+
+static inline GLenum sFormat(size_t channels)
+{
+	switch (channels)
+	{
+	case 1: return GL_LUMINANCE;
+	case 2: return GL_LUMINANCE_ALPHA;
+	case 3: return GL_RGB;
+	default: return GL_RGBA;
+	}
+}
+
+
+void InternalTextureSubImage(struct kaWindow* window, const struct jaImage* image, size_t x, size_t y, size_t width,
+                             size_t height)
+{
+	// Level zero of the bound texture, a region of an image that
+	// holds all of it. GLES2 lacks row lengths, so a packed copy
+	// of the region in those cases
+	const GLenum format = sFormat(image->channels);
+	const size_t stride = image->width * image->channels;
+	const uint8_t* data = (const uint8_t*)image->data + y * stride + x * image->channels;
+	uint8_t* staging = NULL;
+
+	window->stats.texture_uploads += 1;
+	window->stats.texture_bytes += width * height * image->channels;
+
+	if (width == image->width)
+	{
+		glTexSubImage2D(GL_TEXTURE_2D, 0, (GLint)x, (GLint)y, (GLsizei)width, (GLsizei)height, format,
+		                GL_UNSIGNED_BYTE, data);
+	}
+	else if (window->ext.es == false || window->ext.major >= 3)
+	{
+		glPixelStorei(UNPACK_ROW_LENGTH, (GLint)image->width);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, (GLint)x, (GLint)y, (GLsizei)width, (GLsizei)height, format,
+		                GL_UNSIGNED_BYTE, data);
+		glPixelStorei(UNPACK_ROW_LENGTH, 0);
+	}
+	else if ((staging = malloc(width * height * image->channels)) != NULL)
+	{
+		for (size_t row = 0; row < height; row++)
+			memcpy(staging + row * width * image->channels, data + row * stride, width * image->channels);
+
+		glTexSubImage2D(GL_TEXTURE_2D, 0, (GLint)x, (GLint)y, (GLsizei)width, (GLsizei)height, format,
+		                GL_UNSIGNED_BYTE, staging);
+		free(staging);
+	}
+	else
+	{
+		// A row at time, without memory for more
+		for (size_t row = 0; row < height; row++)
+			glTexSubImage2D(GL_TEXTURE_2D, 0, (GLint)x, (GLint)(y + row), (GLsizei)width, 1, format,
+			                GL_UNSIGNED_BYTE, data + row * stride);
+	}
+}
+
+
+static void sUpload(struct kaWindow* window, struct DirtyTexture* d)
+{
+	GLuint old_bind = window->shadow.texture[window->shadow.active_unit];
+	InternalBindTexture(window, window->shadow.active_unit, d->texture->glptr);
+
+	for (size_t i = 0; i < d->rects; i++)
+	{
+		const struct Rect r = d->rect[i];
+		InternalTextureSubImage(window, d->image, r.x0, r.y0, r.x1 - r.x0, r.y1 - r.y0);
+
+		if (d->texture->filter != KA_FILTER_NONE &&
+		    InternalMipmaps(window, d->image, r.x0, r.y0, r.x1 - r.x0, r.y1 - r.y0, d->texture->mipmap,
+		                    d->texture->srgb, false) != 0)
+			glGenerateMipmap(GL_TEXTURE_2D);
+	}
+
+	InternalBindTexture(window, window->shadow.active_unit, old_bind);
+	d->rects = 0;
+}
+
+
+static inline bool sTouches(struct Rect a, struct Rect b)
+{
+	return (a.x0 <= b.x1 && b.x0 <= a.x1 && a.y0 <= b.y1 && b.y0 <= a.y1) ? true : false;
+}
+
+
+static inline struct Rect sUnion(struct Rect a, struct Rect b)
+{
+	return (struct Rect){.x0 = (a.x0 < b.x0) ? a.x0 : b.x0,
+	                     .y0 = (a.y0 < b.y0) ? a.y0 : b.y0,
+	                     .x1 = (a.x1 > b.x1) ? a.x1 : b.x1,
+	                     .y1 = (a.y1 > b.y1) ? a.y1 : b.y1};
+}
+
+
+static inline size_t sArea(struct Rect r)
+{
+	return (r.x1 - r.x0) * (r.y1 - r.y0);
+}
+
+
+static void sAdd(struct DirtyTexture* d, struct Rect r)
+{
+	// Overlapping or adjacent rectangles merge, as uploading
+	// the union is cheaper than two calls. Until none touches,
+	// since a merge can grow into another one
+	for (size_t i = 0; i < d->rects;)
+	{
+		if (sTouches(d->rect[i], r) == true)
+		{
+			r = sUnion(d->rect[i], r);
+			d->rect[i] = d->rect[d->rects - 1];
+			d->rects -= 1;
+			i = 0;
+			continue;
+		}
+
+		i += 1;
+	}
+
+	// Full, merge with the one that grows less
+	if (d->rects == MAX_RECTS)
+	{
+		size_t best = 0;
+		size_t best_growth = SIZE_MAX;
+
+		for (size_t i = 0; i < d->rects; i++)
+		{
+			const size_t growth = sArea(sUnion(d->rect[i], r)) - sArea(d->rect[i]);
+
+			if (growth < best_growth)
+			{
+				best = i;
+				best_growth = growth;
+			}
+		}
+
+		r = sUnion(d->rect[best], r);
+		d->rect[best] = d->rect[d->rects - 1];
+		d->rects -= 1;
+		sAdd(d, r);
+		return;
+	}
+
+	d->rect[d->rects] = r;
+	d->rects += 1;
+}
+
+
+void kaTextureMark(struct kaWindow* window, const struct jaImage* image, size_t x, size_t y, size_t width,
+                   size_t height, struct kaTexture* texture)
+{
+	struct DirtyTexture* d = NULL;
+
+	if (window == NULL || image == NULL || texture == NULL || texture->glptr == 0)
+		return;
+
+	// Clip
+	if (x >= image->width || y >= image->height)
+		return;
+
+	width = (width > image->width - x) ? image->width - x : width;
+	height = (height > image->height - y) ? image->height - y : height;
+
+	if (width == 0 || height == 0)
+		return;
+
+	// Find texture
+	for (size_t i = 0; i < window->dirty.length; i++)
+	{
+		if (window->dirty.textures[i].texture == texture)
+		{
+			d = &window->dirty.textures[i];
+			break;
+		}
+	}
+
+	if (d == NULL)
+	{
+		if (window->dirty.length == window->dirty.capacity)
+		{
+			const size_t new_capacity = (window->dirty.capacity == 0) ? MIN_CAPACITY : window->dirty.capacity * 2;
+			void* temp = realloc(window->dirty.textures, sizeof(struct DirtyTexture) * new_capacity);
+
+			if (temp == NULL)
+			{
+				kaTextureUpdate(window, image, x, y, width, height, texture); // Now, rather than never
+				return;
+			}
+
+			window->dirty.textures = temp;
+			window->dirty.capacity = new_capacity;
+		}
+
+		d = &window->dirty.textures[window->dirty.length];
+		window->dirty.length += 1;
+
+		d->texture = texture;
+		d->image = image;
+		d->rects = 0;
+	}
+
+	// Marks of a previous image go first
+	if (d->image != image)
+	{
+		sUpload(window, d);
+		d->image = image;
+	}
+
+	sAdd(d, (struct Rect){x, y, x + width, y + height});
+}
+
+
+void InternalDirtyFlush(struct kaWindow* window)
+{
+	for (size_t i = 0; i < window->dirty.length; i++)
+		sUpload(window, &window->dirty.textures[i]);
+
+	window->dirty.length = 0;
+}
+
+
+void InternalDirtyForget(struct kaWindow* window, const struct kaTexture* texture, bool upload)
+{
+	for (size_t i = 0; i < window->dirty.length; i++)
+	{
+		if (window->dirty.textures[i].texture == texture)
+		{
+			if (upload == true)
+				sUpload(window, &window->dirty.textures[i]);
+
+			window->dirty.textures[i] = window->dirty.textures[window->dirty.length - 1];
+			window->dirty.length -= 1;
+			return;
+		}
+	}
+}
+
+
+void InternalDirtyFree(struct kaWindow* window)
+{
+	free(window->dirty.textures);
+	window->dirty.textures = NULL;
+	window->dirty.length = 0;
+	window->dirty.capacity = 0;
+}
@@ -0,0 +1,226 @@
+/*-----------------------------
+
+MIT License
+
+Copyright (c) 2020 Alexander Brandt
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-------------------------------
+
+ [context/extensions.c]
+ - Alexander Brandt 2020
+-----------------------------*/
+
+#include "private.h"
+
+
+static void sParseVersion(struct kaWindow* window)
+{
+	const char* version = (const char*)glGetString(GL_VERSION);
+
+	window->ext.es = false;
+	window->ext.major = 2;
+	window->ext.minor = 0;
+
+	if (version == NULL)
+		return;
+
+	// "OpenGL ES 3.2 Mesa", or "4.6 (Compatibility Profile) Mesa" on desktop
+	if (strncmp(version, "OpenGL ES", 9) == 0)
+	{
+		window->ext.es = true;
+		version += 9;
+	}
+
+	while (*version != '\0' && (*version < '0' || *version > '9'))
+		version += 1;
+
+	if (version[0] != '\0' && version[1] == '.' && version[2] >= '0' && version[2] <= '9')
+	{
+		window->ext.major = version[0] - '0';
+		window->ext.minor = version[2] - '0';
+	}
+}
+
+
+static inline bool sVersion(const struct kaWindow* window, int es_major, int es_minor, int desktop_major,
+                            int desktop_minor)
+{
+	if (window->ext.es == true)
+	{
+		if (window->ext.major != es_major)
+			return (window->ext.major > es_major) ? true : false;
+
+		return (window->ext.minor >= es_minor) ? true : false;
+	}
+
+	if (window->ext.major != desktop_major)
+		return (window->ext.major > desktop_major) ? true : false;
+
+	return (window->ext.minor >= desktop_minor) ? true : false;
+}
+
+
+static inline void* sLoad(const char* name)
+{
+	return SDL_GL_GetProcAddress(name);
+}
+
+
+static void sInstancedArrays(struct kaWindow* window)
+{
+	if (sVersion(window, 3, 0, 3, 3) == true)
+	{
+		window->ext.DrawElementsInstanced = (PFNKADRAWELEMENTSINSTANCEDPROC)sLoad("glDrawElementsInstanced");
+		window->ext.VertexAttribDivisor = (PFNKAVERTEXATTRIBDIVISORPROC)sLoad("glVertexAttribDivisor");
+	}
+	else if (SDL_GL_ExtensionSupported("GL_ARB_instanced_arrays") == SDL_TRUE &&
+	         SDL_GL_ExtensionSupported("GL_ARB_draw_instanced") == SDL_TRUE)
+	{
+		window->ext.DrawElementsInstanced = (PFNKADRAWELEMENTSINSTANCEDPROC)sLoad("glDrawElementsInstancedARB");
+		window->ext.VertexAttribDivisor = (PFNKAVERTEXATTRIBDIVISORPROC)sLoad("glVertexAttribDivisorARB");
+	}
+	else if (SDL_GL_ExtensionSupported("GL_EXT_instanced_arrays") == SDL_TRUE)
+	{
+		window->ext.DrawElementsInstanced = (PFNKADRAWELEMENTSINSTANCEDPROC)sLoad("glDrawElementsInstancedEXT");
+		window->ext.VertexAttribDivisor = (PFNKAVERTEXATTRIBDIVISORPROC)sLoad("glVertexAttribDivisorEXT");
+	}
+	else if (SDL_GL_ExtensionSupported("GL_ANGLE_instanced_arrays") == SDL_TRUE)
+	{
+		window->ext.DrawElementsInstanced = (PFNKADRAWELEMENTSINSTANCEDPROC)sLoad("glDrawElementsInstancedANGLE");
+		window->ext.VertexAttribDivisor = (PFNKAVERTEXATTRIBDIVISORPROC)sLoad("glVertexAttribDivisorANGLE");
+	}
+
+	window->ext.instanced_arrays =
+	    (window->ext.DrawElementsInstanced != NULL && window->ext.VertexAttribDivisor != NULL) ? true : false;
+}
+
+
+static void sBaseVertex(struct kaWindow* window)
+{
+	if (sVersion(window, 3, 2, 3, 2) == true ||
+	    SDL_GL_ExtensionSupported("GL_ARB_draw_elements_base_vertex") == SDL_TRUE)
+		window->ext.DrawElementsBaseVertex = (PFNKADRAWELEMENTSBASEVERTEXPROC)sLoad("glDrawElementsBaseVertex");
+	else if (SDL_GL_ExtensionSupported("GL_OES_draw_elements_base_vertex") == SDL_TRUE)
+		window->ext.DrawElementsBaseVertex = (PFNKADRAWELEMENTSBASEVERTEXPROC)sLoad("glDrawElementsBaseVertexOES");
+	else if (SDL_GL_ExtensionSupported("GL_EXT_draw_elements_base_vertex") == SDL_TRUE)
+		window->ext.DrawElementsBaseVertex = (PFNKADRAWELEMENTSBASEVERTEXPROC)sLoad("glDrawElementsBaseVertexEXT");
+}
+
+
+static void sElementIndexUint(struct kaWindow* window)
+{
+	// Core in desktop GL since ever
+	window->ext.element_index_uint =
+	    (window->ext.es == false || window->ext.major >= 3 ||
+	     SDL_GL_ExtensionSupported("GL_OES_element_index_uint") == SDL_TRUE)
+	        ? true
+	        : false;
+}
+
+
+static void sVertexArrayObject(struct kaWindow* window)
+{
+	if (sVersion(window, 3, 0, 3, 0) == true || SDL_GL_ExtensionSupported("GL_ARB_vertex_array_object") == SDL_TRUE)
+	{
+		window->ext.GenVertexArrays = (PFNKAGENVERTEXARRAYSPROC)sLoad("glGenVertexArrays");
+		window->ext.BindVertexArray = (PFNKABINDVERTEXARRAYPROC)sLoad("glBindVertexArray");
+		window->ext.DeleteVertexArrays = (PFNKADELETEVERTEXARRAYSPROC)sLoad("glDeleteVertexArrays");
+	}
+	else if (SDL_GL_ExtensionSupported("GL_OES_vertex_array_object") == SDL_TRUE)
+	{
+		window->ext.GenVertexArrays = (PFNKAGENVERTEXARRAYSPROC)sLoad("glGenVertexArraysOES");
+		window->ext.BindVertexArray = (PFNKABINDVERTEXARRAYPROC)sLoad("glBindVertexArrayOES");
+		window->ext.DeleteVertexArrays = (PFNKADELETEVERTEXARRAYSPROC)sLoad("glDeleteVertexArraysOES");
+	}
+
+	window->ext.vertex_array_object = (window->ext.GenVertexArrays != NULL && window->ext.BindVertexArray != NULL &&
+	                                   window->ext.DeleteVertexArrays != NULL)
+	                                      ? true
+	                                      : false;
+}
+
+
+static void sCompressedFormats(struct kaWindow* window)
+{
+	window->ext.etc1 = (SDL_GL_ExtensionSupported("GL_OES_compressed_ETC1_RGB8_texture") == SDL_TRUE) ? true : false;
+
+	window->ext.etc2 = (sVersion(window, 3, 0, 4, 3) == true ||
+	                    SDL_GL_ExtensionSupported("GL_ARB_ES3_compatibility") == SDL_TRUE)
+	                       ? true
+	                       : false;
+
+	window->ext.s3tc = (SDL_GL_ExtensionSupported("GL_EXT_texture_compression_s3tc") == SDL_TRUE) ? true : false;
+
+	window->ext.bptc = ((window->ext.es == false && sVersion(window, 0, 0, 4, 2) == true) || // Never core in GLES
+	                    SDL_GL_ExtensionSupported("GL_ARB_texture_compression_bptc") == SDL_TRUE ||
+	                    SDL_GL_ExtensionSupported("GL_EXT_texture_compression_bptc") == SDL_TRUE)
+	                       ? true
+	                       : false;
+}
+
+
+static void sFramebuffers(struct kaWindow* window)
+{
+	window->ext.depth24 = (window->ext.es == false || window->ext.major >= 3 ||
+	                       SDL_GL_ExtensionSupported("GL_OES_depth24") == SDL_TRUE)
+	                          ? true
+	                          : false;
+
+	if (sVersion(window, 3, 0, 3, 0) == true ||
+	    SDL_GL_ExtensionSupported("GL_ARB_framebuffer_object") == SDL_TRUE)
+	{
+		window->ext.RenderbufferStorageMultisample =
+		    (PFNKARENDERBUFFERSTORAGEMULTISAMPLEPROC)sLoad("glRenderbufferStorageMultisample");
+		window->ext.BlitFramebuffer = (PFNKABLITFRAMEBUFFERPROC)sLoad("glBlitFramebuffer");
+	}
+	else if (SDL_GL_ExtensionSupported("GL_EXT_framebuffer_multisample") == SDL_TRUE &&
+	         SDL_GL_ExtensionSupported("GL_EXT_framebuffer_blit") == SDL_TRUE)
+	{
+		window->ext.RenderbufferStorageMultisample =
+		    (PFNKARENDERBUFFERSTORAGEMULTISAMPLEPROC)sLoad("glRenderbufferStorageMultisampleEXT");
+		window->ext.BlitFramebuffer = (PFNKABLITFRAMEBUFFERPROC)sLoad("glBlitFramebufferEXT");
+	}
+
+	if (window->ext.RenderbufferStorageMultisample == NULL || window->ext.BlitFramebuffer == NULL)
+	{
+		window->ext.RenderbufferStorageMultisample = NULL;
+		window->ext.BlitFramebuffer = NULL;
+		window->ext.max_samples = 1;
+		return;
+	}
+
+	glGetIntegerv(0x8D57, &window->ext.max_samples); // GL_MAX_SAMPLES, once at startup
+	window->ext.max_samples = (window->ext.max_samples < 1) ? 1 : window->ext.max_samples;
+}
+
+
+void InternalLoadExtensions(struct kaWindow* window)
+{
+	memset(&window->ext, 0, sizeof(window->ext));
+
+	sParseVersion(window);
+	sInstancedArrays(window);
+	sBaseVertex(window);
+	sElementIndexUint(window);
+	sVertexArrayObject(window);
+	sCompressedFormats(window);
+	sFramebuffers(window);
+}
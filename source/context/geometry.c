@@ -0,0 +1,255 @@
+/*-----------------------------
+
+MIT License
+
+Copyright (c) 2020 Alexander Brandt
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-------------------------------
+
+ [context/geometry.c]
+ - Alexander Brandt 2020
+-----------------------------*/
+
+#include "private.h"
+
+
+#define MIN_CAPACITY 16
+
+
+// Free-list, first fit
+// --------------------
+
+static int sInsert(struct kaGeometryFreeList* list, size_t i, struct kaGeometryRange range)
+{
+	if (list->length == list->capacity)
+	{
+		size_t capacity = (list->capacity == 0) ? MIN_CAPACITY : (list->capacity * 2);
+		void* temp = NULL;
+
+		if ((temp = realloc(list->ranges, sizeof(struct kaGeometryRange) * capacity)) == NULL)
+			return 1;
+
+		list->ranges = temp;
+		list->capacity = capacity;
+	}
+
+	memmove(&list->ranges[i + 1], &list->ranges[i], sizeof(struct kaGeometryRange) * (list->length - i));
+	list->ranges[i] = range;
+	list->length += 1;
+
+	return 0;
+}
+
+
+static inline void sRemove(struct kaGeometryFreeList* list, size_t i)
+{
+	memmove(&list->ranges[i], &list->ranges[i + 1], sizeof(struct kaGeometryRange) * (list->length - i - 1));
+	list->length -= 1;
+}
+
+
+static int sAllocate(struct kaGeometryFreeList* list, size_t length, size_t* out_offset)
+{
+	for (size_t i = 0; i < list->length; i++)
+	{
+		if (list->ranges[i].length < length)
+			continue;
+
+		*out_offset = list->ranges[i].offset;
+
+		if (list->ranges[i].length == length)
+			sRemove(list, i);
+		else
+		{
+			list->ranges[i].offset += length;
+			list->ranges[i].length -= length;
+		}
+
+		return 0;
+	}
+
+	return 1;
+}
+
+
+static void sRelease(struct kaGeometryFreeList* list, size_t offset, size_t length)
+{
+	size_t i = 0;
+
+	if (length == 0)
+		return;
+
+	while (i < list->length && list->ranges[i].offset < offset)
+		i += 1;
+
+	// Merge with neighbours
+	const bool prev = (i > 0 && list->ranges[i - 1].offset + list->ranges[i - 1].length == offset);
+	const bool next = (i < list->length && offset + length == list->ranges[i].offset);
+
+	if (prev == true && next == true)
+	{
+		list->ranges[i - 1].length += length + list->ranges[i].length;
+		sRemove(list, i);
+	}
+	else if (prev == true)
+		list->ranges[i - 1].length += length;
+	else if (next == true)
+	{
+		list->ranges[i].offset = offset;
+		list->ranges[i].length += length;
+	}
+
+	// Without memory the range is lost, leaking space but never GL memory
+	else
+		sInsert(list, i, (struct kaGeometryRange){.offset = offset, .length = length});
+}
+
+
+// Public API
+// ----------
+
+int kaGeometryInit(struct kaWindow* window, size_t max_vertices, size_t max_indices, struct kaGeometry* out,
+                   struct jaStatus* st)
+{
+	GLuint old_array = window->shadow.array_buffer;
+	GLuint old_element = window->shadow.element_buffer;
+
+	jaStatusSet(st, "kaGeometryInit", JA_STATUS_SUCCESS, NULL);
+	memset(out, 0, sizeof(struct kaGeometry));
+
+	if (max_vertices == 0 || max_indices == 0)
+	{
+		jaStatusSet(st, "kaGeometryInit", JA_STATUS_INVALID_ARGUMENT, NULL);
+		return 1;
+	}
+
+	if (sInsert(&out->free_vertices, 0, (struct kaGeometryRange){.offset = 0, .length = max_vertices}) != 0 ||
+	    sInsert(&out->free_index, 0, (struct kaGeometryRange){.offset = 0, .length = max_indices}) != 0)
+	{
+		jaStatusSet(st, "kaGeometryInit", JA_STATUS_MEMORY_ERROR, NULL);
+		goto return_failure;
+	}
+
+	// Buffers, without data
+	glGenBuffers(1, &out->vertices.glptr);
+	glGenBuffers(1, &out->index.glptr);
+	InternalBindBuffer(window, GL_ARRAY_BUFFER, out->vertices.glptr);
+	InternalBindBuffer(window, GL_ELEMENT_ARRAY_BUFFER, out->index.glptr);
+
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(sizeof(struct kaVertex) * max_vertices), NULL, GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(sizeof(uint16_t) * max_indices), NULL, GL_STATIC_DRAW);
+
+	if (InternalCheckBuffer(window, GL_ARRAY_BUFFER, out->vertices.glptr, sizeof(struct kaVertex) * max_vertices,
+	                        "kaGeometryInit", st) != 0 ||
+	    InternalCheckBuffer(window, GL_ELEMENT_ARRAY_BUFFER, out->index.glptr, sizeof(uint16_t) * max_indices,
+	                        "kaGeometryInit", st) != 0)
+		goto return_failure;
+
+	out->vertices.length = max_vertices;
+	out->vertices.stride = sizeof(struct kaVertex);
+	out->index.length = max_indices;
+	out->index.format = KA_INDEX_16;
+	out->max_vertices = max_vertices;
+
+	// Bye!
+	InternalBindBuffer(window, GL_ARRAY_BUFFER, old_array);
+	InternalBindBuffer(window, GL_ELEMENT_ARRAY_BUFFER, old_element);
+	return 0;
+
+return_failure:
+	InternalBindBuffer(window, GL_ARRAY_BUFFER, old_array);
+	InternalBindBuffer(window, GL_ELEMENT_ARRAY_BUFFER, old_element);
+	kaGeometryFree(window, out);
+	return 1;
+}
+
+
+void kaGeometryFree(struct kaWindow* window, struct kaGeometry* geometry)
+{
+	kaVerticesFree(window, &geometry->vertices);
+	kaIndexFree(window, &geometry->index);
+
+	if (geometry->free_vertices.ranges != NULL)
+		free(geometry->free_vertices.ranges);
+	if (geometry->free_index.ranges != NULL)
+		free(geometry->free_index.ranges);
+
+	memset(geometry, 0, sizeof(struct kaGeometry));
+}
+
+
+int kaGeometryAdd(struct kaWindow* window, struct kaGeometry* geometry, const struct kaVertex* vertices,
+                  uint16_t vertices_length, const uint16_t* index, size_t index_length, struct kaMesh* out,
+                  struct jaStatus* st)
+{
+	GLuint old_array = window->shadow.array_buffer;
+	GLuint old_element = window->shadow.element_buffer;
+
+	jaStatusSet(st, "kaGeometryAdd", JA_STATUS_SUCCESS, NULL);
+
+	if (vertices_length == 0 || index_length == 0)
+	{
+		jaStatusSet(st, "kaGeometryAdd", JA_STATUS_INVALID_ARGUMENT, NULL);
+		return 1;
+	}
+
+	if (sAllocate(&geometry->free_vertices, vertices_length, &out->base_vertex) != 0)
+	{
+		jaStatusSet(st, "kaGeometryAdd", JA_STATUS_ERROR, "no space for vertices");
+		return 1;
+	}
+
+	if (sAllocate(&geometry->free_index, index_length, &out->first_index) != 0)
+	{
+		sRelease(&geometry->free_vertices, out->base_vertex, vertices_length);
+		jaStatusSet(st, "kaGeometryAdd", JA_STATUS_ERROR, "no space for index");
+		return 1;
+	}
+
+	out->count = index_length;
+	out->vertices_length = vertices_length;
+
+	InternalBindBuffer(window, GL_ARRAY_BUFFER, geometry->vertices.glptr);
+	glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)(sizeof(struct kaVertex) * out->base_vertex),
+	                (GLsizeiptr)(sizeof(struct kaVertex) * vertices_length), vertices);
+	InternalBindBuffer(window, GL_ARRAY_BUFFER, old_array);
+
+	InternalBindBuffer(window, GL_ELEMENT_ARRAY_BUFFER, geometry->index.glptr);
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, (GLintptr)(sizeof(uint16_t) * out->first_index),
+	                (GLsizeiptr)(sizeof(uint16_t) * index_length), index);
+	InternalBindBuffer(window, GL_ELEMENT_ARRAY_BUFFER, old_element);
+
+	return 0;
+}
+
+
+void kaGeometryRemove(struct kaGeometry* geometry, const struct kaMesh* mesh)
+{
+	sRelease(&geometry->free_vertices, mesh->base_vertex, mesh->vertices_length);
+	sRelease(&geometry->free_index, mesh->first_index, mesh->count);
+}
+
+
+inline void kaDrawMesh(struct kaWindow* window, const struct kaGeometry* geometry, const struct kaMesh* mesh)
+{
+	kaSetVertices(window, &geometry->vertices);
+	kaDrawRange(window, &geometry->index, mesh->first_index, mesh->count, mesh->base_vertex);
+}
@@ -0,0 +1,461 @@
+/*-----------------------------
+
+MIT License
+
+Copyright (c) 2020 Alexander Brandt
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-------------------------------
+
+ [context/loader.c]
+ - Alexander Brandt 2020
+-----------------------------*/
+
+#include "private.h"
+#include <stdio.h>
+
+enum Stage
+{
+	STAGE_QUEUED,
+	STAGE_DECODING,
+	STAGE_DECODED,
+	STAGE_FINISHED
+};
+
+struct kaTextureLoad
+{
+	struct kaTextureLoad* next;
+	enum Stage stage; // Guarded by the loader mutex
+	bool cancelled;   // "
+
+	char* filename;
+	bool ktx;
+	int reduce; // Levels to drop, halving dimensions each
+	enum kaTextureFilter filter;
+	enum kaTextureWrap wrap;
+	void (*callback)(struct kaWindow*, struct kaTextureLoad*, void*);
+	void* user_data;
+
+	struct jaImage* image; // Decoded
+	uint8_t* data;         // Or file as is, for ktx
+	size_t size;
+
+	size_t bytes; // Estimated in memory at full resolution, before any reduction
+
+	struct jaStatus decode_st; // Guarded by the loader mutex, set once decoded
+
+	enum kaLoadState state; // Only touched by the main thread
+	struct kaTexture texture;
+	struct jaStatus st; // "
+};
+
+
+static void sAppend(struct kaTextureLoad** list, struct kaTextureLoad* item)
+{
+	item->next = NULL;
+
+	while (*list != NULL)
+		list = &(*list)->next;
+
+	*list = item;
+}
+
+
+static bool sUnlink(struct kaTextureLoad** list, struct kaTextureLoad* item)
+{
+	for (; *list != NULL; list = &(*list)->next)
+	{
+		if (*list == item)
+		{
+			*list = item->next;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+static void sFreeData(struct kaTextureLoad* item)
+{
+	if (item->image != NULL)
+		jaImageDelete(item->image);
+	if (item->data != NULL)
+		free(item->data);
+
+	item->image = NULL;
+	item->data = NULL;
+}
+
+
+static void sFree(struct kaTextureLoad* item)
+{
+	sFreeData(item);
+	free(item->filename);
+	free(item);
+}
+
+
+static void sReadFile(struct kaTextureLoad* item, struct jaStatus* st)
+{
+	FILE* fp = NULL;
+	long size = 0;
+
+	if ((fp = fopen(item->filename, "rb")) == NULL)
+	{
+		jaStatusSet(st, "kaTextureLoadAsync", JA_STATUS_IO_ERROR, item->filename);
+		return;
+	}
+
+	if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) <= 0 || fseek(fp, 0, SEEK_SET) != 0)
+		jaStatusSet(st, "kaTextureLoadAsync", JA_STATUS_IO_ERROR, item->filename);
+	else if ((item->data = malloc((size_t)size)) == NULL)
+		jaStatusSet(st, "kaTextureLoadAsync", JA_STATUS_MEMORY_ERROR, NULL);
+	else if (fread(item->data, (size_t)size, 1, fp) != 1)
+		jaStatusSet(st, "kaTextureLoadAsync", JA_STATUS_IO_ERROR, item->filename);
+	else
+	{
+		item->size = (size_t)size;
+		item->bytes = (size_t)size; // Compressed, as it will be in memory
+	}
+
+	fclose(fp);
+}
+
+
+static void sReduce(struct kaTextureLoad* item)
+{
+	// Box filter, for the residency manager to stream textures without their top levels
+	const size_t factor = (size_t)1 << item->reduce;
+	const struct jaImage* src = item->image;
+	struct jaImage* dst = NULL;
+
+	if (item->image == NULL)
+		return;
+
+	item->bytes = item->image->width * item->image->height * 4; // Drivers pad to four channels
+
+	if (item->image->format != JA_IMAGE_U8 || item->reduce <= 0)
+		return;
+
+	const size_t width = (src->width / factor > 0) ? src->width / factor : 1;
+	const size_t height = (src->height / factor > 0) ? src->height / factor : 1;
+
+	if ((dst = jaImageCreate(JA_IMAGE_U8, width, height, src->channels)) == NULL)
+		return; // Fine, uploaded as is
+
+	const uint8_t* in = src->data;
+	uint8_t* out = dst->data;
+
+	for (size_t y = 0; y < height; y++)
+	{
+		for (size_t x = 0; x < width; x++)
+		{
+			const size_t x1 = (x * factor + factor < src->width) ? x * factor + factor : src->width;
+			const size_t y1 = (y * factor + factor < src->height) ? y * factor + factor : src->height;
+
+			for (size_t c = 0; c < src->channels; c++)
+			{
+				size_t sum = 0;
+
+				for (size_t sy = y * factor; sy < y1; sy++)
+					for (size_t sx = x * factor; sx < x1; sx++)
+						sum += in[(sy * src->width + sx) * src->channels + c];
+
+				const size_t count = (x1 - x * factor) * (y1 - y * factor);
+				*out++ = (uint8_t)((sum + count / 2) / count);
+			}
+		}
+	}
+
+	jaImageDelete(item->image);
+	item->image = dst;
+}
+
+
+static void sDecode(void* data)
+{
+	// A task per load, each taking whatever is pending, so the
+	// order is kept no matter which one runs first
+	struct kaWindow* window = data;
+	struct kaTextureLoad* item = NULL;
+	struct jaStatus st = {0};
+
+	SDL_LockMutex(window->loader.mutex);
+
+	while ((item = window->loader.pending) != NULL)
+	{
+		window->loader.pending = item->next;
+		item->stage = STAGE_DECODING;
+		SDL_UnlockMutex(window->loader.mutex);
+
+		// The slow part, without the lock, as the main thread may poll the status
+		jaStatusSet(&st, "kaTextureLoadAsync", JA_STATUS_SUCCESS, NULL);
+
+		if (item->ktx == true)
+			sReadFile(item, &st);
+		else if ((item->image = jaImageLoad(item->filename, &st)) != NULL)
+			sReduce(item);
+
+		SDL_LockMutex(window->loader.mutex);
+		item->decode_st = st;
+		item->stage = STAGE_DECODED;
+		sAppend(&window->loader.decoded, item);
+	}
+
+	SDL_UnlockMutex(window->loader.mutex);
+}
+
+
+static int sStart(struct kaWindow* window, struct jaStatus* st)
+{
+	if ((window->loader.mutex = SDL_CreateMutex()) == NULL)
+	{
+		jaStatusSet(st, "kaTextureLoadAsync", JA_STATUS_ERROR, "SDL_CreateMutex()");
+		return 1;
+	}
+
+	if (InternalWorkersAcquire("kaTextureLoadAsync", st) != 0)
+		return 1;
+
+	window->loader.workers = true;
+	return 0;
+}
+
+
+static inline size_t sBytes(const struct kaTextureLoad* item)
+{
+	if (item->image != NULL)
+		return item->image->width * item->image->height * item->image->channels;
+
+	return item->size;
+}
+
+
+void InternalLoaderFlush(struct kaWindow* window)
+{
+	struct kaTextureLoad* item = NULL;
+	size_t uploaded = 0;
+
+	if (window->loader.mutex == NULL)
+		return;
+
+	while (1)
+	{
+		SDL_LockMutex(window->loader.mutex);
+
+		// Always one, no matter how large
+		if ((item = window->loader.decoded) == NULL ||
+		    (uploaded > 0 && uploaded + sBytes(item) > window->loader.budget))
+		{
+			SDL_UnlockMutex(window->loader.mutex);
+			break;
+		}
+
+		window->loader.decoded = item->next;
+		item->stage = STAGE_FINISHED;
+		item->st = item->decode_st;
+		SDL_UnlockMutex(window->loader.mutex);
+
+		if (item->cancelled == true)
+		{
+			sFree(item);
+			continue;
+		}
+
+		// Upload
+		uploaded += sBytes(item);
+
+		if (item->st.code == JA_STATUS_SUCCESS)
+		{
+			if (item->ktx == true)
+				kaTextureInitKtxMemory(window, item->data, item->size, item->filter, item->wrap, &item->texture,
+				                       &item->st);
+			else
+				kaTextureInitImage(window, item->image, item->filter, item->wrap, &item->texture, &item->st);
+		}
+
+		item->state = (item->st.code == JA_STATUS_SUCCESS) ? KA_LOAD_READY : KA_LOAD_FAILED;
+		sFreeData(item);
+
+		if (item->callback != NULL)
+			item->callback(window, item, item->user_data);
+	}
+}
+
+
+void InternalLoaderFree(struct kaWindow* window)
+{
+	struct kaTextureLoad* next = NULL;
+
+	if (window->loader.mutex == NULL)
+		return;
+
+	if (window->loader.workers == true)
+	{
+		InternalWorkersCancel(window);
+		InternalWorkersRelease();
+	}
+
+	// Handles not deleted are from the user, that only can delete them
+	struct kaTextureLoad* lists[2] = {window->loader.pending, window->loader.decoded};
+
+	for (int i = 0; i < 2; i++)
+	{
+		for (struct kaTextureLoad* item = lists[i]; item != NULL; item = next)
+		{
+			next = item->next;
+
+			if (item->cancelled == true)
+			{
+				sFree(item);
+				continue;
+			}
+
+			sFreeData(item);
+			item->stage = STAGE_FINISHED;
+			item->state = KA_LOAD_FAILED;
+			jaStatusSet(&item->st, "kaTextureLoadAsync", JA_STATUS_ERROR, "window deleted");
+		}
+	}
+
+	SDL_DestroyMutex(window->loader.mutex);
+	memset(&window->loader, 0, sizeof(window->loader));
+}
+
+
+struct kaTextureLoad* InternalTextureLoad(struct kaWindow* window, const char* filename, enum kaTextureFilter filter,
+                                          enum kaTextureWrap wrap, int reduce,
+                                          void (*callback)(struct kaWindow*, struct kaTextureLoad*, void*),
+                                          void* user_data, struct jaStatus* st)
+{
+	struct kaTextureLoad* item = NULL;
+	const size_t length = strlen(filename);
+
+	if (window->loader.mutex == NULL && sStart(window, st) != 0)
+	{
+		InternalLoaderFree(window);
+		return NULL;
+	}
+
+	if ((item = calloc(1, sizeof(struct kaTextureLoad))) == NULL || (item->filename = malloc(length + 1)) == NULL)
+	{
+		jaStatusSet(st, "kaTextureLoadAsync", JA_STATUS_MEMORY_ERROR, NULL);
+		free(item);
+		return NULL;
+	}
+
+	memcpy(item->filename, filename, length + 1);
+	item->ktx = (length > 4 && strcmp(filename + length - 4, ".ktx") == 0) ? true : false;
+	item->reduce = reduce;
+	item->filter = filter;
+	item->wrap = wrap;
+	item->callback = callback;
+	item->user_data = user_data;
+	item->state = KA_LOAD_PENDING;
+	jaStatusSet(&item->st, "kaTextureLoadAsync", JA_STATUS_SUCCESS, NULL);
+
+	// Bye!
+	SDL_LockMutex(window->loader.mutex);
+	item->stage = STAGE_QUEUED;
+	sAppend(&window->loader.pending, item);
+	SDL_UnlockMutex(window->loader.mutex);
+
+	if (InternalWorkersPost(sDecode, window) != 0)
+	{
+		// Unless a previous task took it already
+		SDL_LockMutex(window->loader.mutex);
+		const bool queued = sUnlink(&window->loader.pending, item);
+		SDL_UnlockMutex(window->loader.mutex);
+
+		if (queued == true)
+		{
+			jaStatusSet(st, "kaTextureLoadAsync", JA_STATUS_MEMORY_ERROR, NULL);
+			sFree(item);
+			return NULL;
+		}
+	}
+
+	return item;
+}
+
+
+void InternalTextureLoadTake(struct kaTextureLoad* item, struct kaTexture* out, size_t* out_bytes)
+{
+	// Mipmaps add a third
+	*out = item->texture;
+	*out_bytes = (item->filter != KA_FILTER_NONE && item->ktx == false) ? item->bytes + item->bytes / 3 : item->bytes;
+	item->texture.glptr = 0;
+	item->state = KA_LOAD_FAILED; // Nothing to get anymore
+}
+
+
+struct kaTextureLoad* kaTextureLoadAsync(struct kaWindow* window, const char* filename, enum kaTextureFilter filter,
+                                         enum kaTextureWrap wrap,
+                                         void (*callback)(struct kaWindow*, struct kaTextureLoad*, void*),
+                                         void* user_data, struct jaStatus* st)
+{
+	jaStatusSet(st, "kaTextureLoadAsync", JA_STATUS_SUCCESS, NULL);
+	return InternalTextureLoad(window, filename, filter, wrap, 0, callback, user_data, st);
+}
+
+
+void kaTextureLoadDelete(struct kaWindow* window, struct kaTextureLoad* item)
+{
+	if (window->loader.mutex == NULL) // Window without loader, or freed it
+	{
+		kaTextureFree(window, &item->texture);
+		sFree(item);
+		return;
+	}
+
+	SDL_LockMutex(window->loader.mutex);
+
+	switch (item->stage)
+	{
+	case STAGE_DECODING: // The worker has it, next flush frees it
+		item->cancelled = true;
+		SDL_UnlockMutex(window->loader.mutex);
+		return;
+	case STAGE_QUEUED: sUnlink(&window->loader.pending, item); break;
+	case STAGE_DECODED: sUnlink(&window->loader.decoded, item); break;
+	default: break;
+	}
+
+	SDL_UnlockMutex(window->loader.mutex);
+
+	kaTextureFree(window, &item->texture);
+	sFree(item);
+}
+
+
+enum kaLoadState kaTextureLoadState(const struct kaTextureLoad* item, struct jaStatus* out)
+{
+	if (out != NULL)
+		*out = item->st;
+
+	return item->state;
+}
+
+
+const struct kaTexture* kaTextureLoadGet(const struct kaWindow* window, const struct kaTextureLoad* item)
+{
+	return (item->state == KA_LOAD_READY) ? &item->texture : &window->default_texture;
+}
@@ -0,0 +1,89 @@
+/*-----------------------------
+
+MIT License
+
+Copyright (c) 2020 Alexander Brandt
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-------------------------------
+
+ [context/matrix.c]
+ - Alexander Brandt 2020
+-----------------------------*/
+
+#include "private.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MATRIX_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define MATRIX_NEON
+#include <arm_neon.h>
+#endif
+
+
+void InternalMatrixMultiply(const struct jaMatrixF4* a, const struct jaMatrixF4* b, struct jaMatrixF4* out)
+{
+	// As GLSL 'a * b', with column major matrices, where 'e[column][row]'.
+	// Every output column is a linear combination of 'a' columns
+
+#if defined(MATRIX_SSE)
+	__m128 a0 = _mm_loadu_ps(a->e[0]);
+	__m128 a1 = _mm_loadu_ps(a->e[1]);
+	__m128 a2 = _mm_loadu_ps(a->e[2]);
+	__m128 a3 = _mm_loadu_ps(a->e[3]);
+
+	for (int c = 0; c < 4; c++)
+	{
+		__m128 r = _mm_mul_ps(a0, _mm_set1_ps(b->e[c][0]));
+		r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(b->e[c][1])));
+		r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(b->e[c][2])));
+		r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(b->e[c][3])));
+		_mm_storeu_ps(out->e[c], r);
+	}
+
+#elif defined(MATRIX_NEON)
+	float32x4_t a0 = vld1q_f32(a->e[0]);
+	float32x4_t a1 = vld1q_f32(a->e[1]);
+	float32x4_t a2 = vld1q_f32(a->e[2]);
+	float32x4_t a3 = vld1q_f32(a->e[3]);
+
+	for (int c = 0; c < 4; c++)
+	{
+		float32x4_t r = vmulq_n_f32(a0, b->e[c][0]);
+		r = vmlaq_n_f32(r, a1, b->e[c][1]);
+		r = vmlaq_n_f32(r, a2, b->e[c][2]);
+		r = vmlaq_n_f32(r, a3, b->e[c][3]);
+		vst1q_f32(out->e[c], r);
+	}
+
+#else
+	struct jaMatrixF4 r; // In case that 'out' is also an input
+
+	for (int c = 0; c < 4; c++)
+	{
+		for (int row = 0; row < 4; row++)
+			r.e[c][row] = a->e[0][row] * b->e[c][0] + a->e[1][row] * b->e[c][1] + a->e[2][row] * b->e[c][2] +
+			              a->e[3][row] * b->e[c][3];
+	}
+
+	*out = r;
+#endif
+}
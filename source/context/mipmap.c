@@ -0,0 +1,539 @@
+/*-----------------------------
+
+MIT License
+
+Copyright (c) 2020 Alexander Brandt
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-------------------------------
+
+ [context/mipmap.c]
+ - Alexander Brandt 2020
+-----------------------------*/
+
+#include "private.h"
+#include <math.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MIPMAP_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define MIPMAP_NEON
+#include <arm_neon.h>
+#endif
+
+#define MAX_TAPS 6
+#define BAND_ROWS 16                // Destination rows per work unit
+#define MIN_THREADED_PIXELS 65536   // Smaller levels done by the calling thread
+#define SRGB_TABLE_LENGTH 4096
+
+struct Region
+{
+	long x0, y0; // Inclusive
+	long x1, y1; // Exclusive
+};
+
+struct Filter // Source index of tap 't' is '2 * x - origin + t'
+{
+	int taps;
+	int origin;
+	float weight[MAX_TAPS];
+};
+
+struct Pass // From a level to the next one
+{
+	const float* src;
+	struct Region src_region; // What 'src' holds, in level coordinates
+	long src_width;
+	long src_height;
+
+	float* dst;
+	struct Region dst_region;
+
+	long channels;
+	const struct Filter* filter;
+	long bands;
+	SDL_atomic_t next_band;
+};
+
+static struct Filter s_box = {.taps = 2, .origin = 0, .weight = {0.5f, 0.5f}};
+static struct Filter s_kaiser = {.taps = 6, .origin = 2}; // Weights on first use
+
+static float s_from_srgb[256];
+static uint8_t s_to_srgb[SRGB_TABLE_LENGTH];
+static bool s_tables = false;
+
+
+// Tables
+// ------
+
+static double sBessel0(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+
+	for (int k = 1; k < 16; k++)
+	{
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+
+	return sum;
+}
+
+
+static void sTables()
+{
+	// Kaiser windowed sinc, at half the frequency, normalized
+	const double alpha = 4.0;
+	const double support = 3.0;
+	double sum = 0.0;
+
+	for (int t = 0; t < s_kaiser.taps; t++)
+	{
+		const double d = (double)(t - s_kaiser.origin) - 0.5; // From the destination center
+		const double x = d / 2.0 * 3.14159265358979323846;
+		const double sinc = (fabs(x) < 1e-8) ? 1.0 : sin(x) / x;
+		const double r = d / support;
+		const double window = sBessel0(alpha * sqrt((r * r < 1.0) ? 1.0 - r * r : 0.0)) / sBessel0(alpha);
+
+		s_kaiser.weight[t] = (float)(sinc * window);
+		sum += sinc * window;
+	}
+
+	for (int t = 0; t < s_kaiser.taps; t++)
+		s_kaiser.weight[t] = (float)(s_kaiser.weight[t] / sum);
+
+	// Transfer functions
+	for (int i = 0; i < 256; i++)
+	{
+		const double c = (double)i / 255.0;
+		s_from_srgb[i] = (float)((c <= 0.04045) ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4));
+	}
+
+	for (int i = 0; i < SRGB_TABLE_LENGTH; i++)
+	{
+		const double l = (double)i / (double)(SRGB_TABLE_LENGTH - 1);
+		const double c = (l <= 0.0031308) ? l * 12.92 : 1.055 * pow(l, 1.0 / 2.4) - 0.055;
+		s_to_srgb[i] = (uint8_t)(c * 255.0 + 0.5);
+	}
+
+	s_tables = true;
+}
+
+
+static inline bool sIsColor(long channels, long c)
+{
+	// Alpha is always linear
+	return (channels == 2 || channels == 4) ? (c != channels - 1) : true;
+}
+
+
+static inline uint8_t sEncode(float v, bool srgb)
+{
+	v = (v < 0.0f) ? 0.0f : (v > 1.0f) ? 1.0f : v;
+
+	if (srgb == true)
+		return s_to_srgb[(int)(v * (float)(SRGB_TABLE_LENGTH - 1) + 0.5f)];
+
+	return (uint8_t)(v * 255.0f + 0.5f);
+}
+
+
+// Filtering
+// ---------
+
+static inline long sClamp(long v, long max)
+{
+	return (v < 0) ? 0 : (v >= max) ? max - 1 : v;
+}
+
+
+static void sHorizontal(const struct Pass* p, const float* row, float* out)
+{
+	const struct Filter* f = p->filter;
+	const long c = p->channels;
+
+#if defined(MIPMAP_SSE) || defined(MIPMAP_NEON)
+	if (c == 4) // A pixel per vector
+	{
+		for (long x = p->dst_region.x0; x < p->dst_region.x1; x++)
+		{
+#if defined(MIPMAP_SSE)
+			__m128 acc = _mm_setzero_ps();
+			for (int t = 0; t < f->taps; t++)
+			{
+				const long sx = sClamp(2 * x - f->origin + t, p->src_width) - p->src_region.x0;
+				acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(f->weight[t]), _mm_loadu_ps(row + sx * 4)));
+			}
+			_mm_storeu_ps(out, acc);
+#else
+			float32x4_t acc = vdupq_n_f32(0.0f);
+			for (int t = 0; t < f->taps; t++)
+			{
+				const long sx = sClamp(2 * x - f->origin + t, p->src_width) - p->src_region.x0;
+				acc = vmlaq_n_f32(acc, vld1q_f32(row + sx * 4), f->weight[t]);
+			}
+			vst1q_f32(out, acc);
+#endif
+			out += 4;
+		}
+
+		return;
+	}
+#endif
+
+	for (long x = p->dst_region.x0; x < p->dst_region.x1; x++)
+	{
+		for (long ch = 0; ch < c; ch++)
+		{
+			float acc = 0.0f;
+
+			for (int t = 0; t < f->taps; t++)
+				acc += f->weight[t] * row[(sClamp(2 * x - f->origin + t, p->src_width) - p->src_region.x0) * c + ch];
+
+			*out++ = acc;
+		}
+	}
+}
+
+
+static void sVertical(const struct Filter* f, const float* const* rows, long length, float* out)
+{
+	long i = 0;
+
+#if defined(MIPMAP_SSE)
+	for (; i + 4 <= length; i += 4)
+	{
+		__m128 acc = _mm_setzero_ps();
+		for (int t = 0; t < f->taps; t++)
+			acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(f->weight[t]), _mm_loadu_ps(rows[t] + i)));
+		_mm_storeu_ps(out + i, acc);
+	}
+#elif defined(MIPMAP_NEON)
+	for (; i + 4 <= length; i += 4)
+	{
+		float32x4_t acc = vdupq_n_f32(0.0f);
+		for (int t = 0; t < f->taps; t++)
+			acc = vmlaq_n_f32(acc, vld1q_f32(rows[t] + i), f->weight[t]);
+		vst1q_f32(out + i, acc);
+	}
+#endif
+
+	for (; i < length; i++)
+	{
+		float acc = 0.0f;
+
+		for (int t = 0; t < f->taps; t++)
+			acc += f->weight[t] * rows[t][i];
+
+		out[i] = acc;
+	}
+}
+
+
+static void sBand(const struct Pass* p, long band, float* scratch)
+{
+	// Horizontal pass of the source rows that the band needs,
+	// into scratch, then vertical ones into the destination
+	const struct Filter* f = p->filter;
+	const long row_length = (p->dst_region.x1 - p->dst_region.x0) * p->channels;
+	const long src_stride = (p->src_region.x1 - p->src_region.x0) * p->channels;
+
+	const long y0 = p->dst_region.y0 + band * BAND_ROWS;
+	const long y1 = (y0 + BAND_ROWS < p->dst_region.y1) ? y0 + BAND_ROWS : p->dst_region.y1;
+	const long first = 2 * y0 - f->origin;
+	const long last = 2 * (y1 - 1) - f->origin + f->taps - 1;
+
+	const float* rows[MAX_TAPS];
+
+	for (long sy = first; sy <= last; sy++)
+	{
+		const long cy = sClamp(sy, p->src_height) - p->src_region.y0;
+		sHorizontal(p, p->src + cy * src_stride, scratch + (sy - first) * row_length);
+	}
+
+	for (long y = y0; y < y1; y++)
+	{
+		for (int t = 0; t < f->taps; t++)
+			rows[t] = scratch + (2 * y - f->origin + t - first) * row_length;
+
+		sVertical(f, rows, row_length, p->dst + (y - p->dst_region.y0) * row_length);
+	}
+}
+
+
+static inline size_t sScratchSize(const struct Pass* p)
+{
+	return sizeof(float) * (size_t)((2 * BAND_ROWS + p->filter->taps) * (p->dst_region.x1 - p->dst_region.x0) *
+	                                p->channels);
+}
+
+
+// Workers
+// -------
+
+static void sJob(void* data)
+{
+	// Bands taken one at time by any thread available
+	struct Pass* p = data;
+	float* scratch = NULL;
+	long band = 0;
+
+	if ((scratch = malloc(sScratchSize(p))) == NULL)
+		return; // Others take its bands, otherwise the level fails
+
+	while ((band = (long)SDL_AtomicAdd(&p->next_band, 1)) < p->bands)
+		sBand(p, band, scratch);
+
+	free(scratch);
+}
+
+
+static int sRun(struct kaWindow* window, struct Pass* p)
+{
+	const long pixels = (p->dst_region.x1 - p->dst_region.x0) * (p->dst_region.y1 - p->dst_region.y0);
+	struct jaStatus st = {0};
+
+	SDL_AtomicSet(&p->next_band, 0);
+
+	if (pixels >= MIN_THREADED_PIXELS && window->mipmap_workers == false &&
+	    InternalWorkersAcquire("kaTextureInit", &st) == 0) // Otherwise fine, without them
+		window->mipmap_workers = true;
+
+	if (pixels >= MIN_THREADED_PIXELS && window->mipmap_workers == true)
+		InternalWorkersFor(sJob, p);
+	else
+		sJob(p);
+
+	return (SDL_AtomicGet(&p->next_band) < p->bands) ? 1 : 0;
+}
+
+
+void InternalMipmapsFree(struct kaWindow* window)
+{
+	if (window->mipmap_workers == true)
+		InternalWorkersRelease();
+
+	window->mipmap_workers = false;
+}
+
+
+// Chain
+// -----
+
+static inline long sFloorDiv2(long v)
+{
+	return (v >= 0) ? v / 2 : -((-v + 1) / 2);
+}
+
+
+static struct Region sAffected(const struct Filter* f, struct Region r, long src_width, long src_height,
+                               long width, long height)
+{
+	// Destination pixels that read any of 'r', a source pixel 's'
+	// is read by those where 2x - origin <= s <= 2x - origin + taps - 1
+	struct Region out;
+
+	out.x0 = (r.x0 == 0) ? 0 : sFloorDiv2(r.x0 - f->taps + 1 + f->origin + 1);
+	out.y0 = (r.y0 == 0) ? 0 : sFloorDiv2(r.y0 - f->taps + 1 + f->origin + 1);
+	out.x1 = (r.x1 == src_width) ? width : sFloorDiv2(r.x1 - 1 + f->origin) + 1;
+	out.y1 = (r.y1 == src_height) ? height : sFloorDiv2(r.y1 - 1 + f->origin) + 1;
+
+	out.x0 = (out.x0 < 0) ? 0 : out.x0;
+	out.y0 = (out.y0 < 0) ? 0 : out.y0;
+	out.x1 = (out.x1 > width) ? width : out.x1;
+	out.y1 = (out.y1 > height) ? height : out.y1;
+	return out;
+}
+
+
+static struct Region sSource(const struct Filter* f, struct Region r, long src_width, long src_height)
+{
+	struct Region out;
+
+	out.x0 = sClamp(2 * r.x0 - f->origin, src_width);
+	out.y0 = sClamp(2 * r.y0 - f->origin, src_height);
+	out.x1 = sClamp(2 * (r.x1 - 1) - f->origin + f->taps - 1, src_width) + 1;
+	out.y1 = sClamp(2 * (r.y1 - 1) - f->origin + f->taps - 1, src_height) + 1;
+	return out;
+}
+
+
+static inline struct Region sUnion(struct Region a, struct Region b)
+{
+	return (struct Region){.x0 = (a.x0 < b.x0) ? a.x0 : b.x0,
+	                       .y0 = (a.y0 < b.y0) ? a.y0 : b.y0,
+	                       .x1 = (a.x1 > b.x1) ? a.x1 : b.x1,
+	                       .y1 = (a.y1 > b.y1) ? a.y1 : b.y1};
+}
+
+
+static inline GLenum sFormat(size_t channels)
+{
+	switch (channels)
+	{
+	case 1: return GL_LUMINANCE;
+	case 2: return GL_LUMINANCE_ALPHA;
+	case 3: return GL_RGB;
+	default: return GL_RGBA;
+	}
+}
+
+
+static void sUpload(const float* level, struct Region held, struct Region region, long width, long height,
+                    long channels, bool srgb, bool whole, GLint l, uint8_t* staging)
+{
+	const long stride = (held.x1 - held.x0) * channels;
+	uint8_t* out = staging;
+
+	for (long y = region.y0; y < region.y1; y++)
+	{
+		const float* in = level + (y - held.y0) * stride + (region.x0 - held.x0) * channels;
+
+		for (long x = region.x0; x < region.x1; x++)
+		{
+			for (long c = 0; c < channels; c++)
+				*out++ = sEncode(*in++, (srgb == true && sIsColor(channels, c) == true) ? true : false);
+		}
+	}
+
+	if (whole == true)
+		glTexImage2D(GL_TEXTURE_2D, l, (GLint)sFormat((size_t)channels), (GLsizei)width, (GLsizei)height, 0,
+		             sFormat((size_t)channels), GL_UNSIGNED_BYTE, staging);
+	else
+		glTexSubImage2D(GL_TEXTURE_2D, l, (GLint)region.x0, (GLint)region.y0, (GLsizei)(region.x1 - region.x0),
+		                (GLsizei)(region.y1 - region.y0), sFormat((size_t)channels), GL_UNSIGNED_BYTE, staging);
+}
+
+
+int InternalMipmaps(struct kaWindow* window, const struct jaImage* image, size_t x, size_t y, size_t width,
+                    size_t height, enum kaMipmapFilter filter, bool srgb, bool whole)
+{
+	// Of the bound texture, level zero already uploaded. Regions
+	// each level needs are found backwards from the last one, as
+	// pixels near the updated ones are read by the filter
+	const struct Filter* f = (filter == KA_MIPMAP_KAISER) ? &s_kaiser : &s_box;
+	const long channels = (long)image->channels;
+
+	long level_width[32];
+	long level_height[32];
+	struct Region affected[32];
+	struct Region held[32];
+	float* data[32] = {NULL};
+	uint8_t* staging = NULL;
+	int levels = 1;
+	int ret = 1;
+
+	if (s_tables == false)
+		sTables();
+
+	level_width[0] = (long)image->width;
+	level_height[0] = (long)image->height;
+	affected[0] = (struct Region){(long)x, (long)y, (long)(x + width), (long)(y + height)};
+
+	while ((level_width[levels - 1] > 1 || level_height[levels - 1] > 1) && levels < 32)
+	{
+		const int l = levels;
+		level_width[l] = (level_width[l - 1] > 1) ? level_width[l - 1] / 2 : 1;
+		level_height[l] = (level_height[l - 1] > 1) ? level_height[l - 1] / 2 : 1;
+		affected[l] = sAffected(f, affected[l - 1], level_width[l - 1], level_height[l - 1], level_width[l],
+		                        level_height[l]);
+		levels += 1;
+	}
+
+	// Allocations only, without data
+	if (image->data == NULL)
+	{
+		for (int l = 1; l < levels; l++)
+			glTexImage2D(GL_TEXTURE_2D, l, (GLint)sFormat(image->channels), (GLsizei)level_width[l],
+			             (GLsizei)level_height[l], 0, sFormat(image->channels), GL_UNSIGNED_BYTE, NULL);
+		return 0;
+	}
+
+	held[levels - 1] = affected[levels - 1];
+
+	for (int l = levels - 1; l > 0; l--)
+		held[l - 1] = sUnion(affected[l - 1], sSource(f, held[l], level_width[l - 1], level_height[l - 1]));
+
+	// Level zero to floats, linear
+	{
+		const struct Region r = held[0];
+		const uint8_t* in = image->data;
+		float* out = NULL;
+
+		if ((data[0] = malloc(sizeof(float) * (size_t)((r.x1 - r.x0) * (r.y1 - r.y0) * channels))) == NULL)
+			goto return_failure;
+
+		out = data[0];
+
+		for (long sy = r.y0; sy < r.y1; sy++)
+		{
+			for (long sx = r.x0; sx < r.x1; sx++)
+			{
+				for (long c = 0; c < channels; c++)
+				{
+					const uint8_t v = in[(sy * level_width[0] + sx) * channels + c];
+					*out++ = (srgb == true && sIsColor(channels, c) == true) ? s_from_srgb[v] : (float)v / 255.0f;
+				}
+			}
+		}
+	}
+
+	if ((staging = malloc((size_t)((held[0].x1 - held[0].x0) * (held[0].y1 - held[0].y0) * channels))) == NULL)
+		goto return_failure;
+
+	// Build and upload, a level at time
+	for (int l = 1; l < levels; l++)
+	{
+		const struct Region r = held[l];
+		struct Pass p = {0};
+
+		if ((data[l] = malloc(sizeof(float) * (size_t)((r.x1 - r.x0) * (r.y1 - r.y0) * channels))) == NULL)
+			goto return_failure;
+
+		p.src = data[l - 1];
+		p.src_region = held[l - 1];
+		p.src_width = level_width[l - 1];
+		p.src_height = level_height[l - 1];
+		p.dst = data[l];
+		p.dst_region = r;
+		p.channels = channels;
+		p.filter = f;
+		p.bands = (r.y1 - r.y0 + BAND_ROWS - 1) / BAND_ROWS;
+
+		if (sRun(window, &p) != 0)
+			goto return_failure;
+
+		sUpload(data[l], r, affected[l], level_width[l], level_height[l], channels, srgb, whole, (GLint)l, staging);
+
+		free(data[l - 1]);
+		data[l - 1] = NULL;
+	}
+
+	ret = 0;
+
+return_failure:
+	for (int l = 0; l < levels; l++)
+		free(data[l]);
+
+	free(staging);
+	return ret;
+}
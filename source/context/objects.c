@@ -31,7 +31,7 @@ SOFTWARE.
 #include "private.h"
 
 
-static inline int sCompileShader(GLuint shader, struct jaStatus* st)
+static inline int sCompileShader(GLuint shader, const char* function, struct jaStatus* st)
 {
 	GLint success = GL_FALSE;
 
@@ -40,7 +40,7 @@ static inline int sCompileShader(GLuint shader, struct jaStatus* st)
 
 	if (success == GL_FALSE)
 	{
-		jaStatusSet(st, "kaProgramInit", JA_STATUS_ERROR, NULL);
+		jaStatusSet(st, function, JA_STATUS_ERROR, NULL);
 		glGetShaderInfoLog(shader, JA_STATUS_EXPL_LEN, NULL, st->explanation);
 		return 1;
 	}
@@ -49,39 +49,39 @@ static inline int sCompileShader(GLuint shader, struct jaStatus* st)
 }
 
 
-int kaProgramInit(struct kaWindow* window, const char* vertex_code, const char* fragment_code, struct kaProgram* out,
-                  struct jaStatus* st)
+static int sProgramInit(struct kaWindow* window, const char* vertex_code, const char* fragment_code,
+                        const struct kaVertexLayout* layout, struct kaProgram* out, const char* function,
+                        struct jaStatus* st)
 {
-	(void)window;
 	GLint success = GL_FALSE;
 	GLuint vertex = 0;
 	GLuint fragment = 0;
 
-	jaStatusSet(st, "kaProgramInit", JA_STATUS_SUCCESS, NULL);
+	memset(out, 0, sizeof(struct kaProgram));
 
 	if (vertex_code == NULL || fragment_code == NULL)
 	{
-		jaStatusSet(st, "kaProgramInit", JA_STATUS_INVALID_ARGUMENT, NULL);
+		jaStatusSet(st, function, JA_STATUS_INVALID_ARGUMENT, NULL);
 		goto return_failure;
 	}
 
 	// Compile shaders
 	if ((vertex = glCreateShader(GL_VERTEX_SHADER)) == 0 || (fragment = glCreateShader(GL_FRAGMENT_SHADER)) == 0)
 	{
-		jaStatusSet(st, "kaProgramInit", JA_STATUS_ERROR, "creating GL shader\n");
+		jaStatusSet(st, function, JA_STATUS_ERROR, "creating GL shader\n");
 		goto return_failure;
 	}
 
 	glShaderSource(vertex, 1, &vertex_code, NULL);
 	glShaderSource(fragment, 1, &fragment_code, NULL);
 
-	if (sCompileShader(vertex, st) != 0 || sCompileShader(fragment, st) != 0)
+	if (sCompileShader(vertex, function, st) != 0 || sCompileShader(fragment, function, st) != 0)
 		goto return_failure;
 
 	// Create program
 	if ((out->glptr = glCreateProgram()) == 0)
 	{
-		jaStatusSet(st, "kaProgramInit", JA_STATUS_ERROR, "creating GL program\n");
+		jaStatusSet(st, function, JA_STATUS_ERROR, "creating GL program\n");
 		goto return_failure;
 	}
 
@@ -91,6 +91,14 @@ int kaProgramInit(struct kaWindow* window, const char* vertex_code, const char*
 	glBindAttribLocation(out->glptr, ATTRIBUTE_POSITION, "vertex_position"); // Before link!
 	glBindAttribLocation(out->glptr, ATTRIBUTE_COLOR, "vertex_color");
 	glBindAttribLocation(out->glptr, ATTRIBUTE_UV, "vertex_uv");
+	glBindAttribLocation(out->glptr, ATTRIBUTE_INSTANCE_LOCAL, "instance_local");
+	glBindAttribLocation(out->glptr, ATTRIBUTE_INSTANCE_COLOR, "instance_color");
+
+	if (layout != NULL)
+	{
+		for (size_t i = 0; i < layout->length; i++)
+			glBindAttribLocation(out->glptr, (GLuint)i, layout->attribute[i].name);
+	}
 
 	// Link
 	glLinkProgram(out->glptr);
@@ -98,11 +106,36 @@ int kaProgramInit(struct kaWindow* window, const char* vertex_code, const char*
 
 	if (success == GL_FALSE)
 	{
-		jaStatusSet(st, "kaProgramInit", JA_STATUS_ERROR, NULL);
+		jaStatusSet(st, function, JA_STATUS_ERROR, NULL);
 		glGetProgramInfoLog(out->glptr, JA_STATUS_EXPL_LEN, NULL, st->explanation);
 		goto return_failure;
 	}
 
+	// Uniforms locations, and samplers that never change
+	out->uniform.world = glGetUniformLocation(out->glptr, "world");
+	out->uniform.local = glGetUniformLocation(out->glptr, "local");
+	out->uniform.camera = glGetUniformLocation(out->glptr, "camera");
+	out->uniform.camera_position = glGetUniformLocation(out->glptr, "camera_position");
+	out->uniform.mvp = glGetUniformLocation(out->glptr, "mvp");
+	out->uniform.dequantize_scale = glGetUniformLocation(out->glptr, "dequantize_scale");
+	out->uniform.dequantize_offset = glGetUniformLocation(out->glptr, "dequantize_offset");
+
+	glUseProgram(out->glptr);
+	{
+		char name[] = "texture0";
+
+		for (GLint i = 0; i < 8; i++)
+		{
+			name[7] = (char)('0' + i);
+			glUniform1i(glGetUniformLocation(out->glptr, name), i);
+		}
+
+		// Identity, as version zero of dequantization
+		glUniform3f(out->uniform.dequantize_scale, 1.0f, 1.0f, 1.0f);
+		glUniform3f(out->uniform.dequantize_offset, 0.0f, 0.0f, 0.0f);
+	}
+	glUseProgram((window->current_program != NULL) ? window->current_program->glptr : 0);
+
 	// Bye!
 	glDeleteShader(vertex); // Set shader to be deleted when glDeleteProgram() happens
 	glDeleteShader(fragment);
@@ -120,54 +153,155 @@ return_failure:
 }
 
 
-inline void kaProgramFree(struct kaWindow* window, struct kaProgram* program)
+int kaProgramInit(struct kaWindow* window, const char* vertex_code, const char* fragment_code, struct kaProgram* out,
+                  struct jaStatus* st)
+{
+	jaStatusSet(st, "kaProgramInit", JA_STATUS_SUCCESS, NULL);
+	return sProgramInit(window, vertex_code, fragment_code, NULL, out, "kaProgramInit", st);
+}
+
+
+int kaProgramInitLayout(struct kaWindow* window, const char* vertex_code, const char* fragment_code,
+                        const struct kaVertexLayout* layout, struct kaProgram* out, struct jaStatus* st)
+{
+	jaStatusSet(st, "kaProgramInitLayout", JA_STATUS_SUCCESS, NULL);
+	return sProgramInit(window, vertex_code, fragment_code, layout, out, "kaProgramInitLayout", st);
+}
+
+
+int kaVertexLayoutInit(const struct kaAttribute* attributes, size_t length, struct kaVertexLayout* out,
+                       struct jaStatus* st)
 {
-	(void)window;
+	jaStatusSet(st, "kaVertexLayoutInit", JA_STATUS_SUCCESS, NULL);
+	memset(out, 0, sizeof(struct kaVertexLayout));
 
+	if (attributes == NULL || length == 0 || length > KA_MAX_LAYOUT_ATTRIBUTES)
+	{
+		jaStatusSet(st, "kaVertexLayoutInit", JA_STATUS_INVALID_ARGUMENT, "attributes length");
+		return 1;
+	}
+
+	for (size_t i = 0; i < length; i++)
+	{
+		const struct kaAttribute* a = &attributes[i];
+
+		if (a->name == NULL || a->components < 1 || a->components > 4 || a->slot < 0 ||
+		    a->slot >= KA_MAX_LAYOUT_SLOTS)
+		{
+			jaStatusSet(st, "kaVertexLayoutInit", JA_STATUS_INVALID_ARGUMENT, "attribute");
+			return 1;
+		}
+
+		switch (a->type)
+		{
+		case KA_ATTRIBUTE_BYTE:
+			out->gl_type[i] = GL_BYTE;
+			break;
+		case KA_ATTRIBUTE_UNSIGNED_BYTE:
+			out->gl_type[i] = GL_UNSIGNED_BYTE;
+			break;
+		case KA_ATTRIBUTE_SHORT:
+			out->gl_type[i] = GL_SHORT;
+			break;
+		case KA_ATTRIBUTE_UNSIGNED_SHORT:
+			out->gl_type[i] = GL_UNSIGNED_SHORT;
+			break;
+		default: out->gl_type[i] = GL_FLOAT; // KA_ATTRIBUTE_FLOAT
+		}
+
+		out->attribute[i] = *a;
+		out->mask |= (uint32_t)1 << i;
+		out->slots = (a->slot + 1 > out->slots) ? (a->slot + 1) : out->slots;
+	}
+
+	out->length = length;
+	return 0;
+}
+
+
+inline void kaProgramFree(struct kaWindow* window, struct kaProgram* program)
+{
 	if (program != NULL && program->glptr != 0)
 	{
+		if (window != NULL && window->current_program == program)
+			window->current_program = NULL;
+
 		glDeleteProgram(program->glptr);
 		program->glptr = 0;
 	}
 }
 
 
-int kaVerticesInit(struct kaWindow* window, const struct kaVertex* data, uint16_t length, struct kaVertices* out,
-                   struct jaStatus* st)
+static inline GLenum sUsage(enum kaUsage usage)
 {
-	(void)window;
-	GLint reported_size = 0;
-	GLint old_bind = 0;
+	switch (usage)
+	{
+	case KA_USAGE_DYNAMIC: return GL_DYNAMIC_DRAW;
+	case KA_USAGE_STREAM: return GL_STREAM_DRAW;
+	default: return GL_STATIC_DRAW;
+	}
+}
 
-	jaStatusSet(st, "kaVerticesInit", JA_STATUS_SUCCESS, NULL);
 
-	glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &old_bind);
-	glGenBuffers(1, &out->glptr);
-	glBindBuffer(GL_ARRAY_BUFFER, out->glptr); // Before ask if is!
+int InternalCheckBuffer(const struct kaWindow* window, GLenum target, GLuint glptr, size_t size, const char* function,
+                        struct jaStatus* st)
+{
+	// Queries are synchronous, on threaded drivers they wait for the
+	// GL thread to catch up. So only made on debug, where errors are
+	// also checked once per frame by kaContextUpdate()
+	GLint reported_size = 0;
+
+	if (window->debug == false)
+		return 0;
 
-	if (glIsBuffer(out->glptr) == GL_FALSE)
+	if (glIsBuffer(glptr) == GL_FALSE)
 	{
-		jaStatusSet(st, "kaVerticesInit", JA_STATUS_ERROR, "creating GL buffer");
-		goto return_failure;
+		jaStatusSet(st, function, JA_STATUS_ERROR, "creating GL buffer");
+		return 1;
 	}
 
-	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(sizeof(struct kaVertex) * length), data, GL_STREAM_DRAW);
-	glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &reported_size);
+	glGetBufferParameteriv(target, GL_BUFFER_SIZE, &reported_size);
 
-	if ((size_t)reported_size != (sizeof(struct kaVertex) * length))
+	if ((size_t)reported_size != size)
 	{
-		jaStatusSet(st, "kaVerticesInit", JA_STATUS_ERROR, "attaching data");
-		goto return_failure;
+		jaStatusSet(st, function, JA_STATUS_ERROR, "attaching data");
+		return 1;
 	}
 
+	return 0;
+}
+
+
+static int sVerticesInit(const char* function, struct kaWindow* window, GLuint glptr, const void* data, size_t size,
+                         size_t length, enum kaVertexFormat format, enum kaUsage usage, struct kaVertices* out,
+                         struct jaStatus* st)
+{
+	GLuint old_bind = window->shadow.array_buffer;
+
+	out->glptr = glptr; // Zero to generate one
+
+	if (out->glptr == 0)
+		glGenBuffers(1, &out->glptr);
+
+	InternalBindBuffer(window, GL_ARRAY_BUFFER, out->glptr);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(size * length), data, sUsage(usage));
+
+	if (InternalCheckBuffer(window, GL_ARRAY_BUFFER, out->glptr, size * length, function, st) != 0)
+		goto return_failure;
+
 	out->length = length;
+	out->stride = size;
+	out->format = format;
+	out->usage = usage;
+	out->scale = (struct jaVectorF3){1.0f, 1.0f, 1.0f};
+	out->offset = (struct jaVectorF3){0.0f, 0.0f, 0.0f};
 
 	// Bye!
-	glBindBuffer(GL_ARRAY_BUFFER, (GLuint)old_bind);
+	InternalBindBuffer(window, GL_ARRAY_BUFFER, old_bind);
 	return 0;
 
 return_failure:
-	glBindBuffer(GL_ARRAY_BUFFER, (GLuint)old_bind);
+	InternalBindBuffer(window, GL_ARRAY_BUFFER, old_bind);
 
 	if (out->glptr != 0)
 		glDeleteBuffers(1, &out->glptr);
@@ -176,53 +310,320 @@ return_failure:
 }
 
 
-inline void kaVerticesFree(struct kaWindow* window, struct kaVertices* vertices)
+int kaVerticesInit(struct kaWindow* window, const struct kaVertex* data, size_t length, struct kaVertices* out,
+                   struct jaStatus* st)
 {
-	(void)window;
+	jaStatusSet(st, "kaVerticesInit", JA_STATUS_SUCCESS, NULL);
+	return sVerticesInit("kaVerticesInit", window, 0, data, sizeof(struct kaVertex), length, KA_VERTEX_FLOAT,
+	                     KA_USAGE_STATIC, out, st);
+}
 
-	if (vertices != NULL && vertices->glptr != 0)
+
+int kaVerticesInitUsage(struct kaWindow* window, const struct kaVertex* data, size_t length, enum kaUsage usage,
+                        struct kaVertices* out, struct jaStatus* st)
+{
+	jaStatusSet(st, "kaVerticesInitUsage", JA_STATUS_SUCCESS, NULL);
+	return sVerticesInit("kaVerticesInitUsage", window, 0, data, sizeof(struct kaVertex), length, KA_VERTEX_FLOAT,
+	                     usage, out, st);
+}
+
+
+int kaVerticesInitBulk(struct kaWindow* window, size_t count, const struct kaVertex* const* data, const size_t* length,
+                       struct kaVertices* out, struct jaStatus* st)
+{
+	GLuint* names = NULL;
+	size_t i = 0;
+
+	jaStatusSet(st, "kaVerticesInitBulk", JA_STATUS_SUCCESS, NULL);
+
+	if (count == 0)
+		return 0;
+
+	if ((names = malloc(sizeof(GLuint) * count)) == NULL)
 	{
-		glDeleteBuffers(1, &vertices->glptr);
-		vertices->glptr = 0;
+		jaStatusSet(st, "kaVerticesInitBulk", JA_STATUS_MEMORY_ERROR, NULL);
+		return 1;
 	}
+
+	// A single call for all names, rather than one per buffer
+	glGenBuffers((GLsizei)count, names);
+
+	for (i = 0; i < count; i++)
+	{
+		if (sVerticesInit("kaVerticesInitBulk", window, names[i], (data != NULL) ? data[i] : NULL,
+		                  sizeof(struct kaVertex), length[i], KA_VERTEX_FLOAT, KA_USAGE_STATIC, &out[i], st) != 0)
+			goto return_failure;
+	}
+
+	free(names);
+	return 0;
+
+return_failure:
+	for (size_t u = 0; u < i; u++)
+		kaVerticesFree(window, &out[u]);
+
+	if ((count - i) > 1) // Failed one deleted by sVerticesInit()
+		glDeleteBuffers((GLsizei)(count - i - 1), names + i + 1);
+
+	free(names);
+	return 1;
 }
 
 
-int kaIndexInit(struct kaWindow* window, const uint16_t* data, size_t length, struct kaIndex* out, struct jaStatus* st)
+static int sVertexArrayInit(const char* function, struct kaWindow* window, const struct kaVertices* vertices,
+                            const struct kaVertexLayout* layout, const struct kaVertices* const* slots,
+                            const struct kaIndex* index, struct kaVertexArray* out, struct jaStatus* st)
 {
-	(void)window;
-	GLint reported_size = 0;
-	GLint old_bind = 0;
+	const struct kaVertexArray* old_va = window->vao.current;
 
-	jaStatusSet(st, "kaIndexInit", JA_STATUS_SUCCESS, NULL);
+	memset(out, 0, sizeof(struct kaVertexArray));
 
-	glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &old_bind);
-	glGenBuffers(1, &out->glptr);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, out->glptr); // Before ask if is!
+	if (index == NULL || (layout == NULL && vertices == NULL) || (layout != NULL && slots == NULL))
+	{
+		jaStatusSet(st, function, JA_STATUS_INVALID_ARGUMENT, NULL);
+		return 1;
+	}
+
+	out->vertices = vertices;
+	out->layout = layout;
+	out->index = index;
 
-	if (glIsBuffer(out->glptr) == GL_FALSE)
+	if (layout != NULL)
 	{
-		jaStatusSet(st, "kaIndexInit", JA_STATUS_ERROR, "creating GL buffer");
-		goto return_failure;
+		for (int i = 0; i < layout->slots; i++)
+		{
+			if ((out->slots[i] = slots[i]) == NULL)
+			{
+				jaStatusSet(st, function, JA_STATUS_INVALID_ARGUMENT, "slots");
+				return 1;
+			}
+		}
 	}
 
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(sizeof(uint16_t) * length), data, GL_STREAM_DRAW);
-	glGetBufferParameteriv(GL_ELEMENT_ARRAY_BUFFER, GL_BUFFER_SIZE, &reported_size);
+	// Without support kaSetVertexArray() sets vertices as always
+	if (window->ext.vertex_array_object == false)
+		return 0;
+
+	window->ext.GenVertexArrays(1, &out->glptr);
 
-	if ((size_t)reported_size != (sizeof(uint16_t) * length))
+	if (out->glptr == 0)
 	{
-		jaStatusSet(st, "kaIndexInit", JA_STATUS_ERROR, "attaching data");
-		goto return_failure;
+		jaStatusSet(st, function, JA_STATUS_ERROR, "creating GL vertex array");
+		return 1;
 	}
 
+	// A new object has nothing enabled nor bound, as 'bound' says,
+	// from there record the state within it
+	InternalBindVertexArray(window, out);
+	InternalAttributes(window, (layout != NULL) ? layout->mask : DEFAULT_ATTRIBUTES);
+	InternalPointers(window, 0);
+	InternalBindBuffer(window, GL_ELEMENT_ARRAY_BUFFER, index->glptr);
+	InternalBindVertexArray(window, old_va);
+
+	return 0;
+}
+
+
+int kaVertexArrayInit(struct kaWindow* window, const struct kaVertices* vertices, const struct kaIndex* index,
+                      struct kaVertexArray* out, struct jaStatus* st)
+{
+	jaStatusSet(st, "kaVertexArrayInit", JA_STATUS_SUCCESS, NULL);
+	return sVertexArrayInit("kaVertexArrayInit", window, vertices, NULL, NULL, index, out, st);
+}
+
+
+int kaVertexArrayInitLayout(struct kaWindow* window, const struct kaVertexLayout* layout,
+                            const struct kaVertices* const* slots, const struct kaIndex* index,
+                            struct kaVertexArray* out, struct jaStatus* st)
+{
+	jaStatusSet(st, "kaVertexArrayInitLayout", JA_STATUS_SUCCESS, NULL);
+	return sVertexArrayInit("kaVertexArrayInitLayout", window, NULL, layout, slots, index, out, st);
+}
+
+
+inline void kaVertexArrayFree(struct kaWindow* window, struct kaVertexArray* va)
+{
+	if (window != NULL && va != NULL && va->glptr != 0)
+	{
+		if (window->vao.current == va)
+			InternalBindVertexArray(window, NULL);
+
+		window->ext.DeleteVertexArrays(1, &va->glptr);
+		va->glptr = 0;
+	}
+}
+
+
+int kaVerticesInitData(struct kaWindow* window, const void* data, size_t stride, size_t length,
+                       struct kaVertices* out, struct jaStatus* st)
+{
+	jaStatusSet(st, "kaVerticesInitData", JA_STATUS_SUCCESS, NULL);
+	return sVerticesInit("kaVerticesInitData", window, 0, data, stride, length, KA_VERTEX_LAYOUT, KA_USAGE_STATIC,
+	                     out, st);
+}
+
+
+int kaVerticesInitCompact(struct kaWindow* window, const struct kaVertexCompact* data, size_t length,
+                          struct kaVertices* out, struct jaStatus* st)
+{
+	jaStatusSet(st, "kaVerticesInitCompact", JA_STATUS_SUCCESS, NULL);
+	return sVerticesInit("kaVerticesInitCompact", window, 0, data, sizeof(struct kaVertexCompact), length,
+	                     KA_VERTEX_COMPACT, KA_USAGE_STATIC, out, st);
+}
+
+
+static inline uint8_t sUnorm8(float v)
+{
+	v = (v < 0.0f) ? 0.0f : (v > 1.0f) ? 1.0f : v;
+	return (uint8_t)(v * 255.0f + 0.5f);
+}
+
+static inline uint16_t sUnorm16(float v)
+{
+	v = (v < 0.0f) ? 0.0f : (v > 1.0f) ? 1.0f : v;
+	return (uint16_t)(v * 65535.0f + 0.5f);
+}
+
+static inline int16_t sSnorm16(float v)
+{
+	v = (v < -1.0f) ? -1.0f : (v > 1.0f) ? 1.0f : v;
+	return (int16_t)((v < 0.0f) ? (v * 32767.0f - 0.5f) : (v * 32767.0f + 0.5f));
+}
+
+
+inline struct kaVertexCompact kaVertexToCompact(struct kaVertex v)
+{
+	return (struct kaVertexCompact){
+	    .position = v.position,
+	    .color = {sUnorm8(v.color.r), sUnorm8(v.color.g), sUnorm8(v.color.b), sUnorm8(v.color.a)},
+	    .uv = {sUnorm16(v.uv.x), sUnorm16(v.uv.y)}};
+}
+
+
+int kaVerticesInitQuantized(struct kaWindow* window, const struct kaVertex* data, size_t length,
+                            struct kaVertices* out, struct jaStatus* st)
+{
+	struct kaVertexQuantized* temp = NULL;
+	struct jaVectorF3 min = {0.0f, 0.0f, 0.0f};
+	struct jaVectorF3 max = {0.0f, 0.0f, 0.0f};
+	struct jaVectorF3 scale = {1.0f, 1.0f, 1.0f};
+	struct jaVectorF3 offset = {0.0f, 0.0f, 0.0f};
+
+	jaStatusSet(st, "kaVerticesInitQuantized", JA_STATUS_SUCCESS, NULL);
+
+	if (data == NULL)
+	{
+		jaStatusSet(st, "kaVerticesInitQuantized", JA_STATUS_INVALID_ARGUMENT, NULL);
+		return 1;
+	}
+
+	if ((temp = malloc(sizeof(struct kaVertexQuantized) * length)) == NULL && length != 0)
+	{
+		jaStatusSet(st, "kaVerticesInitQuantized", JA_STATUS_MEMORY_ERROR, NULL);
+		return 1;
+	}
+
+	// Bounds, mapped to the normalized range
+	for (size_t i = 0; i < length; i++)
+	{
+		min = (i == 0) ? data[i].position : min;
+		max = (i == 0) ? data[i].position : max;
+
+		min.x = (data[i].position.x < min.x) ? data[i].position.x : min.x;
+		min.y = (data[i].position.y < min.y) ? data[i].position.y : min.y;
+		min.z = (data[i].position.z < min.z) ? data[i].position.z : min.z;
+		max.x = (data[i].position.x > max.x) ? data[i].position.x : max.x;
+		max.y = (data[i].position.y > max.y) ? data[i].position.y : max.y;
+		max.z = (data[i].position.z > max.z) ? data[i].position.z : max.z;
+	}
+
+	offset = (struct jaVectorF3){(min.x + max.x) / 2.0f, (min.y + max.y) / 2.0f, (min.z + max.z) / 2.0f};
+	scale.x = (max.x > min.x) ? ((max.x - min.x) / 2.0f) : 1.0f;
+	scale.y = (max.y > min.y) ? ((max.y - min.y) / 2.0f) : 1.0f;
+	scale.z = (max.z > min.z) ? ((max.z - min.z) / 2.0f) : 1.0f;
+
+	for (size_t i = 0; i < length; i++)
+	{
+		const struct kaVertexCompact c = kaVertexToCompact(data[i]);
+
+		temp[i].position[0] = sSnorm16((data[i].position.x - offset.x) / scale.x);
+		temp[i].position[1] = sSnorm16((data[i].position.y - offset.y) / scale.y);
+		temp[i].position[2] = sSnorm16((data[i].position.z - offset.z) / scale.z);
+		temp[i].position[3] = 0;
+
+		memcpy(temp[i].color, c.color, sizeof(c.color));
+		memcpy(temp[i].uv, c.uv, sizeof(c.uv));
+	}
+
+	if (sVerticesInit("kaVerticesInitQuantized", window, 0, temp, sizeof(struct kaVertexQuantized), length,
+	                  KA_VERTEX_QUANTIZED, KA_USAGE_STATIC, out, st) != 0)
+	{
+		free(temp);
+		return 1;
+	}
+
+	out->scale = scale;
+	out->offset = offset;
+
+	free(temp);
+	return 0;
+}
+
+
+inline void kaVerticesFree(struct kaWindow* window, struct kaVertices* vertices)
+{
+	if (vertices != NULL && vertices->glptr != 0)
+	{
+		if (window != NULL)
+		{
+			if (window->current_vertices == vertices)
+				window->current_vertices = NULL;
+
+			for (int i = 0; i < KA_MAX_LAYOUT_SLOTS; i++)
+			{
+				if (window->current_slots[i] == vertices)
+				{
+					window->current_layout = NULL;
+					window->current_vertices = NULL;
+				}
+			}
+
+			InternalForgetBuffer(window, vertices->glptr);
+		}
+
+		glDeleteBuffers(1, &vertices->glptr);
+		vertices->glptr = 0;
+	}
+}
+
+
+static int sIndexInit(const char* function, struct kaWindow* window, GLuint glptr, const void* data, size_t length,
+                      enum kaIndexFormat format, enum kaUsage usage, struct kaIndex* out, struct jaStatus* st)
+{
+	const size_t size = (format == KA_INDEX_32) ? sizeof(uint32_t) : sizeof(uint16_t);
+	GLuint old_bind = window->shadow.element_buffer;
+
+	out->glptr = glptr; // Zero to generate one
+
+	if (out->glptr == 0)
+		glGenBuffers(1, &out->glptr);
+
+	InternalBindBuffer(window, GL_ELEMENT_ARRAY_BUFFER, out->glptr);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(size * length), data, sUsage(usage));
+
+	if (InternalCheckBuffer(window, GL_ELEMENT_ARRAY_BUFFER, out->glptr, size * length, function, st) != 0)
+		goto return_failure;
+
 	out->length = length;
+	out->format = format;
+	out->usage = usage;
 
 	// Bye!
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, (GLuint)old_bind);
+	InternalBindBuffer(window, GL_ELEMENT_ARRAY_BUFFER, old_bind);
 	return 0;
 
 return_failure:
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, (GLuint)old_bind);
+	InternalBindBuffer(window, GL_ELEMENT_ARRAY_BUFFER, old_bind);
 
 	if (out->glptr != 0)
 		glDeleteBuffers(1, &out->glptr);
@@ -231,61 +632,246 @@ return_failure:
 }
 
 
-inline void kaIndexFree(struct kaWindow* window, struct kaIndex* index)
+int kaIndexInit(struct kaWindow* window, const uint16_t* data, size_t length, struct kaIndex* out, struct jaStatus* st)
+{
+	jaStatusSet(st, "kaIndexInit", JA_STATUS_SUCCESS, NULL);
+	return sIndexInit("kaIndexInit", window, 0, data, length, KA_INDEX_16, KA_USAGE_STATIC, out, st);
+}
+
+
+int kaIndexInit32(struct kaWindow* window, const uint32_t* data, size_t length, struct kaIndex* out,
+                  struct jaStatus* st)
+{
+	jaStatusSet(st, "kaIndexInit32", JA_STATUS_SUCCESS, NULL);
+
+	if (window->ext.element_index_uint == false)
+	{
+		jaStatusSet(st, "kaIndexInit32", JA_STATUS_UNSUPPORTED_FEATURE, "32 bits index");
+		return 1;
+	}
+
+	return sIndexInit("kaIndexInit32", window, 0, data, length, KA_INDEX_32, KA_USAGE_STATIC, out, st);
+}
+
+
+int kaIndexInitUsage(struct kaWindow* window, const uint16_t* data, size_t length, enum kaUsage usage,
+                     struct kaIndex* out, struct jaStatus* st)
 {
-	(void)window;
+	jaStatusSet(st, "kaIndexInitUsage", JA_STATUS_SUCCESS, NULL);
+	return sIndexInit("kaIndexInitUsage", window, 0, data, length, KA_INDEX_16, usage, out, st);
+}
 
+
+int kaIndexInitBulk(struct kaWindow* window, size_t count, const uint16_t* const* data, const size_t* length,
+                    struct kaIndex* out, struct jaStatus* st)
+{
+	GLuint* names = NULL;
+	size_t i = 0;
+
+	jaStatusSet(st, "kaIndexInitBulk", JA_STATUS_SUCCESS, NULL);
+
+	if (count == 0)
+		return 0;
+
+	if ((names = malloc(sizeof(GLuint) * count)) == NULL)
+	{
+		jaStatusSet(st, "kaIndexInitBulk", JA_STATUS_MEMORY_ERROR, NULL);
+		return 1;
+	}
+
+	glGenBuffers((GLsizei)count, names);
+
+	for (i = 0; i < count; i++)
+	{
+		if (sIndexInit("kaIndexInitBulk", window, names[i], (data != NULL) ? data[i] : NULL, length[i], KA_INDEX_16,
+		               KA_USAGE_STATIC, &out[i], st) != 0)
+			goto return_failure;
+	}
+
+	free(names);
+	return 0;
+
+return_failure:
+	for (size_t u = 0; u < i; u++)
+		kaIndexFree(window, &out[u]);
+
+	if ((count - i) > 1)
+		glDeleteBuffers((GLsizei)(count - i - 1), names + i + 1);
+
+	free(names);
+	return 1;
+}
+
+
+static void sUpdate(struct kaWindow* window, GLenum target, GLuint glptr, enum kaUsage usage, const void* data,
+                    size_t size, size_t offset, size_t length, size_t total_length)
+{
+	GLuint old_bind = (target == GL_ARRAY_BUFFER) ? window->shadow.array_buffer : window->shadow.element_buffer;
+
+	if (data == NULL || offset >= total_length)
+		return;
+
+	if (length > total_length - offset)
+		length = total_length - offset;
+
+	InternalBindBuffer(window, target, glptr);
+
+	// All of it, orphaning the old storage in case that GL still reads
+	// from it, rather than waiting for that to finish
+	if (offset == 0 && length == total_length)
+		glBufferData(target, (GLsizeiptr)(size * length), data, sUsage(usage));
+	else
+		glBufferSubData(target, (GLintptr)(size * offset), (GLsizeiptr)(size * length), data);
+
+	InternalBindBuffer(window, target, old_bind);
+}
+
+
+void kaIndexUpdate(struct kaWindow* window, const void* data, size_t offset, size_t length, struct kaIndex* out)
+{
+	const size_t size = (out->format == KA_INDEX_32) ? sizeof(uint32_t) : sizeof(uint16_t);
+	sUpdate(window, GL_ELEMENT_ARRAY_BUFFER, out->glptr, out->usage, data, size, offset, length, out->length);
+}
+
+
+void kaVerticesUpdate(struct kaWindow* window, const void* data, size_t offset, size_t length,
+                      struct kaVertices* out)
+{
+	sUpdate(window, GL_ARRAY_BUFFER, out->glptr, out->usage, data, out->stride, offset, length, out->length);
+}
+
+
+inline void kaIndexFree(struct kaWindow* window, struct kaIndex* index)
+{
 	if (index != NULL && index->glptr != 0)
 	{
+		if (window != NULL)
+			InternalForgetBuffer(window, index->glptr);
+
 		glDeleteBuffers(1, &index->glptr);
 		index->glptr = 0;
 	}
 }
 
 
-int kaTextureInitImage(struct kaWindow* window, const struct jaImage* image, enum kaTextureFilter filter,
-                       enum kaTextureWrap wrap, struct kaTexture* out, struct jaStatus* st)
+int kaInstancesInit(struct kaWindow* window, const struct kaInstance* data, size_t length, struct kaInstances* out,
+                    struct jaStatus* st)
 {
-	(void)window;
-	GLint old_bind = 0;
+	GLuint old_bind = window->shadow.array_buffer;
 
-	jaStatusSet(st, "kaTextureInit", JA_STATUS_SUCCESS, NULL);
+	jaStatusSet(st, "kaInstancesInit", JA_STATUS_SUCCESS, NULL);
+	out->copy = NULL;
 
-	if (image->format != JA_IMAGE_U8)
+	// Without hardware support instances are drawn from a copy in memory
+	if (window->ext.instanced_arrays == false)
 	{
-		jaStatusSet(st, "kaTextureInit", JA_STATUS_ERROR, "only 8 bits per component images supported");
-		return 1;
+		out->glptr = 0;
+
+		if ((out->copy = malloc(sizeof(struct kaInstance) * length)) == NULL && length != 0)
+		{
+			jaStatusSet(st, "kaInstancesInit", JA_STATUS_MEMORY_ERROR, NULL);
+			return 1;
+		}
+
+		if (data != NULL)
+			memcpy(out->copy, data, sizeof(struct kaInstance) * length);
+
+		out->length = length;
+		return 0;
+	}
+
+	glGenBuffers(1, &out->glptr);
+	InternalBindBuffer(window, GL_ARRAY_BUFFER, out->glptr);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(sizeof(struct kaInstance) * length), data, GL_STREAM_DRAW);
+
+	if (InternalCheckBuffer(window, GL_ARRAY_BUFFER, out->glptr, sizeof(struct kaInstance) * length,
+	                        "kaInstancesInit", st) != 0)
+		goto return_failure;
+
+	out->length = length;
+
+	// Bye!
+	InternalBindBuffer(window, GL_ARRAY_BUFFER, old_bind);
+	return 0;
+
+return_failure:
+	InternalBindBuffer(window, GL_ARRAY_BUFFER, old_bind);
+
+	if (out->glptr != 0)
+		glDeleteBuffers(1, &out->glptr);
+
+	return 1;
+}
+
+
+void kaInstancesUpdate(struct kaWindow* window, const struct kaInstance* data, size_t offset, size_t length,
+                       struct kaInstances* out)
+{
+	GLuint old_bind = window->shadow.array_buffer;
+
+	if (data == NULL || offset >= out->length)
+		return;
+
+	if (length > out->length - offset)
+		length = out->length - offset;
+
+	if (out->copy != NULL)
+	{
+		memcpy(out->copy + offset, data, sizeof(struct kaInstance) * length);
+		return;
 	}
 
-	glGetIntegerv(GL_TEXTURE_BINDING_2D, &old_bind);
-	glGenTextures(1, &out->glptr);
-	glBindTexture(GL_TEXTURE_2D, out->glptr); // Before ask if is!
+	InternalBindBuffer(window, GL_ARRAY_BUFFER, out->glptr);
+	glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)(sizeof(struct kaInstance) * offset),
+	                (GLsizeiptr)(sizeof(struct kaInstance) * length), data);
+	InternalBindBuffer(window, GL_ARRAY_BUFFER, old_bind);
+}
+
+
+inline void kaInstancesFree(struct kaWindow* window, struct kaInstances* instances)
+{
+	if (instances == NULL)
+		return;
 
-	if (glIsTexture(out->glptr) == GL_FALSE)
+	if (instances->glptr != 0)
 	{
-		jaStatusSet(st, "kaTextureInit", JA_STATUS_ERROR, "creating GL texture");
-		return 1;
+		if (window != NULL)
+			InternalForgetBuffer(window, instances->glptr);
+
+		glDeleteBuffers(1, &instances->glptr);
+		instances->glptr = 0;
 	}
 
-	out->filter = filter;
-	out->wrap = wrap;
+	if (instances->copy != NULL)
+	{
+		free(instances->copy);
+		instances->copy = NULL;
+	}
+}
+
 
+void InternalTextureParameters(enum kaTextureFilter filter, enum kaTextureWrap wrap, bool mipmaps)
+{
+	// Of bound texture. Without mipmaps minification can't use
+	// them, GLES2 considers incomplete textures that try to
 	switch (filter)
 	{
 	case KA_FILTER_BILINEAR:
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (mipmaps == true) ? GL_LINEAR_MIPMAP_NEAREST : GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 		break;
 	case KA_FILTER_TRILINEAR:
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (mipmaps == true) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 		break;
 	case KA_FILTER_PIXEL_BILINEAR:
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+		                (mipmaps == true) ? GL_NEAREST_MIPMAP_NEAREST : GL_NEAREST);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 		break;
 	case KA_FILTER_PIXEL_TRILINEAR:
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+		                (mipmaps == true) ? GL_NEAREST_MIPMAP_LINEAR : GL_NEAREST);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 		break;
 	case KA_FILTER_NONE:
@@ -307,6 +893,33 @@ int kaTextureInitImage(struct kaWindow* window, const struct jaImage* image, enu
 		break;
 	default: break; // KA_REPEAT is the default value
 	}
+}
+
+
+static int sTextureInit(struct kaWindow* window, GLuint glptr, const struct jaImage* image, enum kaTextureFilter filter,
+                        enum kaTextureWrap wrap, enum kaMipmapFilter mipmap, bool srgb, struct kaTexture* out,
+                        struct jaStatus* st)
+{
+	GLuint old_bind = window->shadow.texture[window->shadow.active_unit];
+
+	out->glptr = glptr;
+	out->residency_id = 0;
+	InternalBindTexture(window, window->shadow.active_unit, out->glptr);
+
+	// Synchronous, see InternalCheckBuffer()
+	if (window->debug == true && glIsTexture(out->glptr) == GL_FALSE)
+	{
+		jaStatusSet(st, "kaTextureInit", JA_STATUS_ERROR, "creating GL texture");
+		InternalBindTexture(window, window->shadow.active_unit, old_bind);
+		return 1;
+	}
+
+	out->filter = filter;
+	out->wrap = wrap;
+	out->mipmap = mipmap;
+	out->srgb = srgb;
+
+	InternalTextureParameters(filter, wrap, true);
 
 	switch (image->channels)
 	{
@@ -329,14 +942,96 @@ int kaTextureInitImage(struct kaWindow* window, const struct jaImage* image, enu
 	default: break;
 	}
 
-	if (filter != KA_FILTER_NONE)
+	// The driver one as fallback, usually a slow synchronous thing
+	if (filter != KA_FILTER_NONE &&
+	    InternalMipmaps(window, image, 0, 0, image->width, image->height, mipmap, srgb, true) != 0)
 		glGenerateMipmap(GL_TEXTURE_2D);
 
-	glBindTexture(GL_TEXTURE_2D, (GLuint)old_bind);
+	InternalBindTexture(window, window->shadow.active_unit, old_bind);
 	return 0;
 }
 
 
+inline int kaTextureInitImage(struct kaWindow* window, const struct jaImage* image, enum kaTextureFilter filter,
+                              enum kaTextureWrap wrap, struct kaTexture* out, struct jaStatus* st)
+{
+	return kaTextureInitMipmaps(window, image, filter, wrap, KA_MIPMAP_BOX, false, out, st);
+}
+
+
+int kaTextureInitMipmaps(struct kaWindow* window, const struct jaImage* image, enum kaTextureFilter filter,
+                         enum kaTextureWrap wrap, enum kaMipmapFilter mipmap, bool srgb, struct kaTexture* out,
+                         struct jaStatus* st)
+{
+	GLuint glptr = 0;
+
+	jaStatusSet(st, "kaTextureInit", JA_STATUS_SUCCESS, NULL);
+
+	if (image->format != JA_IMAGE_U8)
+	{
+		jaStatusSet(st, "kaTextureInit", JA_STATUS_ERROR, "only 8 bits per component images supported");
+		return 1;
+	}
+
+	glGenTextures(1, &glptr);
+
+	if (sTextureInit(window, glptr, image, filter, wrap, mipmap, srgb, out, st) != 0)
+	{
+		glDeleteTextures(1, &glptr);
+		return 1;
+	}
+
+	return 0;
+}
+
+
+int kaTextureInitBulk(struct kaWindow* window, size_t count, const struct jaImage* const* images,
+                      enum kaTextureFilter filter, enum kaTextureWrap wrap, struct kaTexture* out, struct jaStatus* st)
+{
+	GLuint* names = NULL;
+	size_t i = 0;
+
+	jaStatusSet(st, "kaTextureInitBulk", JA_STATUS_SUCCESS, NULL);
+
+	for (i = 0; i < count; i++)
+	{
+		if (images[i]->format != JA_IMAGE_U8)
+		{
+			jaStatusSet(st, "kaTextureInitBulk", JA_STATUS_ERROR, "only 8 bits per component images supported");
+			return 1;
+		}
+	}
+
+	if (count == 0)
+		return 0;
+
+	if ((names = malloc(sizeof(GLuint) * count)) == NULL)
+	{
+		jaStatusSet(st, "kaTextureInitBulk", JA_STATUS_MEMORY_ERROR, NULL);
+		return 1;
+	}
+
+	glGenTextures((GLsizei)count, names);
+
+	for (i = 0; i < count; i++)
+	{
+		if (sTextureInit(window, names[i], images[i], filter, wrap, KA_MIPMAP_BOX, false, &out[i], st) != 0)
+			goto return_failure;
+	}
+
+	free(names);
+	return 0;
+
+return_failure:
+	for (size_t u = 0; u < i; u++)
+		kaTextureFree(window, &out[u]);
+
+	glDeleteTextures((GLsizei)(count - i), names + i);
+	free(names);
+	return 1;
+}
+
+
 int kaTextureInitFilename(struct kaWindow* window, const char* filename, enum kaTextureFilter filter,
                           enum kaTextureWrap wrap, struct kaTexture* out, struct jaStatus* st)
 {
@@ -360,46 +1055,33 @@ int kaTextureInitFilename(struct kaWindow* window, const char* filename, enum ka
 void kaTextureUpdate(struct kaWindow* window, const struct jaImage* image, size_t x, size_t y, size_t width,
                      size_t height, struct kaTexture* out)
 {
-	(void)window;
-	GLint old_bind = 0;
+	GLuint old_bind = window->shadow.texture[window->shadow.active_unit];
 
-	glGetIntegerv(GL_TEXTURE_BINDING_2D, &old_bind);
-	glBindTexture(GL_TEXTURE_2D, out->glptr);
+	// Marks first, otherwise they would land later over newer pixels
+	InternalDirtyForget(window, out, true);
 
-	switch (image->channels)
-	{
-	case 1:
-		glTexSubImage2D(GL_TEXTURE_2D, 0, (GLsizei)x, (GLsizei)y, (GLsizei)width, (GLsizei)height, GL_LUMINANCE,
-		                GL_UNSIGNED_BYTE, image->data);
-		break;
-	case 2:
-		glTexSubImage2D(GL_TEXTURE_2D, 0, (GLsizei)x, (GLsizei)y, (GLsizei)width, (GLsizei)height, GL_LUMINANCE_ALPHA,
-		                GL_UNSIGNED_BYTE, image->data);
-		break;
-	case 3:
-		glTexSubImage2D(GL_TEXTURE_2D, 0, (GLsizei)x, (GLsizei)y, (GLsizei)width, (GLsizei)height, GL_RGB,
-		                GL_UNSIGNED_BYTE, image->data);
-		break;
-	case 4:
-		glTexSubImage2D(GL_TEXTURE_2D, 0, (GLsizei)x, (GLsizei)y, (GLsizei)width, (GLsizei)height, GL_RGBA,
-		                GL_UNSIGNED_BYTE, image->data);
-		break;
-	default: break;
-	}
+	InternalBindTexture(window, window->shadow.active_unit, out->glptr);
+	InternalTextureSubImage(window, image, x, y, width, height);
 
-	if (out->filter != KA_FILTER_NONE)
+	// Only levels around the region
+	if (out->filter != KA_FILTER_NONE &&
+	    InternalMipmaps(window, image, x, y, width, height, out->mipmap, out->srgb, false) != 0)
 		glGenerateMipmap(GL_TEXTURE_2D);
 
-	glBindTexture(GL_TEXTURE_2D, (GLuint)old_bind);
+	InternalBindTexture(window, window->shadow.active_unit, old_bind);
 }
 
 
 inline void kaTextureFree(struct kaWindow* window, struct kaTexture* texture)
 {
-	(void)window;
-
 	if (texture != NULL && texture->glptr != 0)
 	{
+		if (window != NULL)
+		{
+			InternalForgetTexture(window, texture->glptr);
+			InternalDirtyForget(window, texture, false);
+		}
+
 		glDeleteTextures(1, &texture->glptr);
 		texture->glptr = 0;
 	}
@@ -0,0 +1,574 @@
+/*-----------------------------
+
+MIT License
+
+Copyright (c) 2020 Alexander Brandt
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-------------------------------
+
+ [context/occlusion.c]
+ - Alexander Brandt 2020
+-----------------------------*/
+
+#include "private.h"
+#include <math.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define OCCLUSION_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define OCCLUSION_NEON
+#include <arm_neon.h>
+#endif
+
+
+#define BAND_HEIGHT 16 // Rows that a thread rasterizes at once
+#define MAX_LEVELS 16
+#define MIN_CAPACITY 256
+
+struct Triangle
+{
+	int min_x, max_x; // Clamped to the buffer, inclusive
+	int min_y, max_y; // "
+
+	float a[3], b[3], c[3]; // Edge functions 'a * x + b * y + c', positive inside
+	float za, zb, zc;       // Depth plane, in the same way
+};
+
+struct kaOcclusion
+{
+	int width; // Multiple of four
+	int height;
+
+	int levels;
+	int level_width[MAX_LEVELS];
+	int level_height[MAX_LEVELS];
+	float* level[MAX_LEVELS]; // Hierarchical-z, first one the depth buffer itself, rest with maximums of 2x2
+
+	struct jaMatrixF4 world_camera;
+
+	struct Triangle* triangles;
+	size_t length;
+	size_t capacity;
+
+	float (*clip)[4]; // Transformed vertices
+	size_t clip_capacity;
+
+	bool workers; // Holding a reference of the shared ones
+	int bands;
+	SDL_atomic_t next_band;
+};
+
+
+// Rasterization
+// -------------
+
+#if defined(OCCLUSION_SSE)
+static void sRow(const struct Triangle* t, float* row, int y, int x0, int x1)
+{
+	const __m128 py = _mm_set1_ps((float)y + 0.5f);
+	const __m128 offset = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+	const __m128 zero = _mm_setzero_ps();
+
+	const __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t->b[0]), py), _mm_set1_ps(t->c[0]));
+	const __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t->b[1]), py), _mm_set1_ps(t->c[1]));
+	const __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t->b[2]), py), _mm_set1_ps(t->c[2]));
+	const __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t->zb), py), _mm_set1_ps(t->zc));
+
+	const __m128 a0 = _mm_set1_ps(t->a[0]);
+	const __m128 a1 = _mm_set1_ps(t->a[1]);
+	const __m128 a2 = _mm_set1_ps(t->a[2]);
+	const __m128 za = _mm_set1_ps(t->za);
+
+	for (int x = x0; x < x1; x += 4)
+	{
+		const __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offset);
+
+		__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), e0), zero);
+		inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), e1), zero));
+		inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), e2), zero));
+
+		if (_mm_movemask_ps(inside) == 0)
+			continue;
+
+		const __m128 old = _mm_loadu_ps(row + x);
+		const __m128 nearer = _mm_min_ps(old, _mm_add_ps(_mm_mul_ps(za, px), z));
+		_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+	}
+}
+
+#elif defined(OCCLUSION_NEON)
+static void sRow(const struct Triangle* t, float* row, int y, int x0, int x1)
+{
+	const float py = (float)y + 0.5f;
+	const float32x4_t offset = {0.5f, 1.5f, 2.5f, 3.5f};
+	const float32x4_t zero = vdupq_n_f32(0.0f);
+
+	const float32x4_t e0 = vdupq_n_f32(t->b[0] * py + t->c[0]);
+	const float32x4_t e1 = vdupq_n_f32(t->b[1] * py + t->c[1]);
+	const float32x4_t e2 = vdupq_n_f32(t->b[2] * py + t->c[2]);
+	const float32x4_t z = vdupq_n_f32(t->zb * py + t->zc);
+
+	for (int x = x0; x < x1; x += 4)
+	{
+		const float32x4_t px = vaddq_f32(vdupq_n_f32((float)x), offset);
+
+		uint32x4_t inside = vcgeq_f32(vmlaq_n_f32(e0, px, t->a[0]), zero);
+		inside = vandq_u32(inside, vcgeq_f32(vmlaq_n_f32(e1, px, t->a[1]), zero));
+		inside = vandq_u32(inside, vcgeq_f32(vmlaq_n_f32(e2, px, t->a[2]), zero));
+
+		const float32x4_t old = vld1q_f32(row + x);
+		const float32x4_t nearer = vminq_f32(old, vmlaq_n_f32(z, px, t->za));
+		vst1q_f32(row + x, vbslq_f32(inside, nearer, old));
+	}
+}
+
+#else
+static void sRow(const struct Triangle* t, float* row, int y, int x0, int x1)
+{
+	const float py = (float)y + 0.5f;
+
+	for (int x = x0; x < x1; x++)
+	{
+		const float px = (float)x + 0.5f;
+
+		if (t->a[0] * px + t->b[0] * py + t->c[0] < 0.0f || t->a[1] * px + t->b[1] * py + t->c[1] < 0.0f ||
+		    t->a[2] * px + t->b[2] * py + t->c[2] < 0.0f)
+			continue;
+
+		const float z = t->za * px + t->zb * py + t->zc;
+
+		if (z < row[x])
+			row[x] = z;
+	}
+}
+#endif
+
+
+static void sWork(void* data)
+{
+	struct kaOcclusion* o = data;
+	int band = 0;
+
+	// Bands taken one at time by any thread available, no two threads
+	// touch the same rows so there is nothing else to synchronize
+	while ((band = SDL_AtomicAdd(&o->next_band, 1)) < o->bands)
+	{
+		const int y0 = band * BAND_HEIGHT;
+		const int y1 = (y0 + BAND_HEIGHT < o->height) ? (y0 + BAND_HEIGHT) : o->height;
+
+		for (int i = y0 * o->width; i < y1 * o->width; i++)
+			o->level[0][i] = 1.0f;
+
+		for (size_t i = 0; i < o->length; i++)
+		{
+			const struct Triangle* t = &o->triangles[i];
+
+			if (t->max_y < y0 || t->min_y >= y1)
+				continue;
+
+			const int ty0 = (t->min_y > y0) ? t->min_y : y0;
+			const int ty1 = (t->max_y + 1 < y1) ? (t->max_y + 1) : y1;
+			const int x0 = t->min_x & ~3; // Aligned for the simd versions
+			const int x1 = ((t->max_x + 4) & ~3);
+
+			for (int y = ty0; y < ty1; y++)
+				sRow(t, o->level[0] + y * o->width, y, x0, x1);
+		}
+	}
+}
+
+
+static void sBuildPyramid(struct kaOcclusion* o)
+{
+	for (int l = 1; l < o->levels; l++)
+	{
+		const int pw = o->level_width[l - 1];
+		const int ph = o->level_height[l - 1];
+		const float* prev = o->level[l - 1];
+
+		for (int y = 0; y < o->level_height[l]; y++)
+		{
+			const int y0 = y * 2;
+			const int y1 = (y0 + 1 < ph) ? (y0 + 1) : y0;
+
+			for (int x = 0; x < o->level_width[l]; x++)
+			{
+				const int x0 = x * 2;
+				const int x1 = (x0 + 1 < pw) ? (x0 + 1) : x0;
+
+				// Farthest depth, what hides anything behind for sure
+				const float a = fmaxf(prev[y0 * pw + x0], prev[y0 * pw + x1]);
+				const float b = fmaxf(prev[y1 * pw + x0], prev[y1 * pw + x1]);
+				o->level[l][y * o->level_width[l] + x] = fmaxf(a, b);
+			}
+		}
+	}
+}
+
+
+// Occluders
+// ---------
+
+static int sGrow(struct kaOcclusion* o, size_t triangles, size_t vertices)
+{
+	if (o->length + triangles > o->capacity)
+	{
+		size_t capacity = (o->capacity == 0) ? MIN_CAPACITY : o->capacity;
+		void* temp = NULL;
+
+		while (o->length + triangles > capacity)
+			capacity *= 2;
+
+		if ((temp = realloc(o->triangles, sizeof(struct Triangle) * capacity)) == NULL)
+			return 1;
+
+		o->triangles = temp;
+		o->capacity = capacity;
+	}
+
+	if (vertices > o->clip_capacity)
+	{
+		void* temp = NULL;
+
+		if ((temp = realloc(o->clip, sizeof(float) * 4 * vertices)) == NULL)
+			return 1;
+
+		o->clip = temp;
+		o->clip_capacity = vertices;
+	}
+
+	return 0;
+}
+
+
+static void sAddTriangle(struct kaOcclusion* o, const float* v0, const float* v1, const float* v2)
+{
+	struct Triangle* t = &o->triangles[o->length];
+	float x[3], y[3], z[3];
+	const float* v[3] = {v0, v1, v2};
+
+	// To buffer coordinates, 'y' going up as GL does
+	for (int i = 0; i < 3; i++)
+	{
+		x[i] = (v[i][0] / v[i][3] * 0.5f + 0.5f) * (float)o->width;
+		y[i] = (v[i][1] / v[i][3] * 0.5f + 0.5f) * (float)o->height;
+		z[i] = (v[i][2] / v[i][3] * 0.5f + 0.5f);
+	}
+
+	// Back faces and degenerated ones, for closed meshes front
+	// faces already hide the same, for open ones is conservative
+	for (int i = 0; i < 3; i++)
+	{
+		const int n = (i + 1) % 3;
+		t->a[i] = y[i] - y[n];
+		t->b[i] = x[n] - x[i];
+		t->c[i] = (y[n] - y[i]) * x[i] - (x[n] - x[i]) * y[i];
+	}
+
+	const float area = t->a[0] * x[2] + t->b[0] * y[2] + t->c[0];
+
+	if (area <= 0.0f)
+		return;
+
+	// Edge 'i' is opposite to vertex 'i + 2'
+	t->za = (t->a[1] * z[0] + t->a[2] * z[1] + t->a[0] * z[2]) / area;
+	t->zb = (t->b[1] * z[0] + t->b[2] * z[1] + t->b[0] * z[2]) / area;
+	t->zc = (t->c[1] * z[0] + t->c[2] * z[1] + t->c[0] * z[2]) / area;
+
+	// Clamped as floats, as vertices close to the near plane may lie far outside
+	const float min_x = fminf(x[0], fminf(x[1], x[2]));
+	const float max_x = fmaxf(x[0], fmaxf(x[1], x[2]));
+	const float min_y = fminf(y[0], fminf(y[1], y[2]));
+	const float max_y = fmaxf(y[0], fmaxf(y[1], y[2]));
+
+	if (max_x < 0.0f || max_y < 0.0f || min_x >= (float)o->width || min_y >= (float)o->height)
+		return;
+
+	t->min_x = (int)floorf(fmaxf(min_x, 0.0f));
+	t->max_x = (int)ceilf(fminf(max_x, (float)o->width));
+	t->min_y = (int)floorf(fmaxf(min_y, 0.0f));
+	t->max_y = (int)ceilf(fminf(max_y, (float)o->height));
+
+	t->max_x = (t->max_x >= o->width) ? (o->width - 1) : t->max_x;
+	t->max_y = (t->max_y >= o->height) ? (o->height - 1) : t->max_y;
+
+	o->length += 1;
+}
+
+
+static inline float sNear(const float* v)
+{
+	return v[2] + v[3]; // Distance to the near plane, as GL clips 'z >= -w'
+}
+
+
+static void sClipAndAdd(struct kaOcclusion* o, const float* v0, const float* v1, const float* v2)
+{
+	const float* in[3] = {v0, v1, v2};
+	float out[4][4];
+	int length = 0;
+
+	if (sNear(v0) >= 0.0f && sNear(v1) >= 0.0f && sNear(v2) >= 0.0f)
+	{
+		sAddTriangle(o, v0, v1, v2);
+		return;
+	}
+
+	// Sutherland-Hodgman against the near plane, a triangle becomes
+	// nothing, a triangle or a quad (on the same space of a triangle)
+	for (int i = 0; i < 3; i++)
+	{
+		const float* a = in[i];
+		const float* b = in[(i + 1) % 3];
+
+		if (sNear(a) >= 0.0f)
+		{
+			memcpy(out[length], a, sizeof(float) * 4);
+			length += 1;
+		}
+
+		if ((sNear(a) >= 0.0f) != (sNear(b) >= 0.0f))
+		{
+			const float f = sNear(a) / (sNear(a) - sNear(b));
+
+			for (int c = 0; c < 4; c++)
+				out[length][c] = a[c] + (b[c] - a[c]) * f;
+
+			length += 1;
+		}
+	}
+
+	if (length >= 3)
+		sAddTriangle(o, out[0], out[1], out[2]);
+	if (length == 4)
+		sAddTriangle(o, out[0], out[2], out[3]);
+}
+
+
+// Public API
+// ----------
+
+struct kaOcclusion* kaOcclusionCreate(int width, int height, struct jaStatus* st)
+{
+	struct kaOcclusion* o = NULL;
+
+	jaStatusSet(st, "kaOcclusionCreate", JA_STATUS_SUCCESS, NULL);
+
+	if (width <= 0 || height <= 0)
+	{
+		jaStatusSet(st, "kaOcclusionCreate", JA_STATUS_INVALID_ARGUMENT, NULL);
+		return NULL;
+	}
+
+	if ((o = calloc(1, sizeof(struct kaOcclusion))) == NULL)
+		goto return_failure_memory;
+
+	o->width = (width + 3) & ~3;
+	o->height = height;
+	o->bands = (height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+
+	// Pyramid
+	{
+		int w = o->width;
+		int h = o->height;
+
+		for (o->levels = 0; o->levels < MAX_LEVELS; o->levels++)
+		{
+			o->level_width[o->levels] = w;
+			o->level_height[o->levels] = h;
+
+			if ((o->level[o->levels] = malloc(sizeof(float) * (size_t)(w * h))) == NULL)
+				goto return_failure_memory;
+
+			for (int i = 0; i < w * h; i++)
+				o->level[o->levels][i] = 1.0f;
+
+			if (w == 1 && h == 1)
+			{
+				o->levels += 1;
+				break;
+			}
+
+			w = (w + 1) / 2;
+			h = (h + 1) / 2;
+		}
+	}
+
+	// Workers, the calling thread being one more
+	if (InternalWorkersAcquire("kaOcclusionCreate", st) == 0)
+		o->workers = true;
+	else
+		jaStatusSet(st, "kaOcclusionCreate", JA_STATUS_SUCCESS, NULL); // Fine, alone
+
+	return o;
+
+return_failure_memory:
+	jaStatusSet(st, "kaOcclusionCreate", JA_STATUS_MEMORY_ERROR, NULL);
+	if (o != NULL)
+		kaOcclusionDelete(o);
+
+	return NULL;
+}
+
+
+void kaOcclusionDelete(struct kaOcclusion* o)
+{
+	if (o->workers == true)
+		InternalWorkersRelease();
+
+	for (int i = 0; i < MAX_LEVELS; i++)
+	{
+		if (o->level[i] != NULL)
+			free(o->level[i]);
+	}
+
+	if (o->triangles != NULL)
+		free(o->triangles);
+	if (o->clip != NULL)
+		free(o->clip);
+
+	free(o);
+}
+
+
+void kaOcclusionBegin(struct kaWindow* window, struct kaOcclusion* o)
+{
+	o->world_camera = *InternalWorldCamera(window);
+	o->length = 0;
+}
+
+
+void kaOcclusionDraw(struct kaOcclusion* o, struct jaMatrixF4 local, const struct kaVertex* vertices,
+                     uint16_t vertices_length, const uint16_t* index, size_t index_length)
+{
+	struct jaMatrixF4 m;
+
+	// Without memory we lose an occluder, still correct, just less culling
+	if (sGrow(o, index_length / 3 * 2, vertices_length) != 0)
+		return;
+
+	InternalMatrixMultiply(&o->world_camera, &local, &m);
+
+	for (uint16_t i = 0; i < vertices_length; i++)
+	{
+		const struct jaVectorF3 p = vertices[i].position;
+
+		for (int c = 0; c < 4; c++)
+			o->clip[i][c] = m.e[0][c] * p.x + m.e[1][c] * p.y + m.e[2][c] * p.z + m.e[3][c];
+	}
+
+	for (size_t i = 0; i + 2 < index_length; i += 3)
+	{
+		if (index[i] >= vertices_length || index[i + 1] >= vertices_length || index[i + 2] >= vertices_length)
+			continue;
+
+		sClipAndAdd(o, o->clip[index[i]], o->clip[index[i + 1]], o->clip[index[i + 2]]);
+	}
+}
+
+
+void kaOcclusionEnd(struct kaOcclusion* o)
+{
+	SDL_AtomicSet(&o->next_band, 0);
+
+	if (o->workers == true)
+		InternalWorkersFor(sWork, o);
+	else
+		sWork(o);
+
+	sBuildPyramid(o);
+}
+
+
+bool kaOcclusionTestBox(const struct kaOcclusion* o, struct kaAABBox box)
+{
+	float min_x = INFINITY, min_y = INFINITY, min_z = INFINITY;
+	float max_x = -INFINITY, max_y = -INFINITY;
+
+	// Screen rectangle and nearest depth of the box
+	for (int i = 0; i < 8; i++)
+	{
+		const struct jaMatrixF4* m = &o->world_camera;
+		const float x = (i & 1) ? box.max.x : box.min.x;
+		const float y = (i & 2) ? box.max.y : box.min.y;
+		const float z = (i & 4) ? box.max.z : box.min.z;
+
+		const float w = m->e[0][3] * x + m->e[1][3] * y + m->e[2][3] * z + m->e[3][3];
+		const float cz = m->e[0][2] * x + m->e[1][2] * y + m->e[2][2] * z + m->e[3][2];
+
+		if (w <= 0.0f || cz + w < 0.0f)
+			return true; // Crossing the near plane, too close to hide
+
+		const float sx = ((m->e[0][0] * x + m->e[1][0] * y + m->e[2][0] * z + m->e[3][0]) / w * 0.5f + 0.5f);
+		const float sy = ((m->e[0][1] * x + m->e[1][1] * y + m->e[2][1] * z + m->e[3][1]) / w * 0.5f + 0.5f);
+		const float sz = (cz / w * 0.5f + 0.5f);
+
+		min_x = fminf(min_x, sx * (float)o->width);
+		max_x = fmaxf(max_x, sx * (float)o->width);
+		min_y = fminf(min_y, sy * (float)o->height);
+		max_y = fmaxf(max_y, sy * (float)o->height);
+		min_z = fminf(min_z, sz);
+	}
+
+	// Outside the screen is a frustum culling matter
+	if (max_x < 0.0f || max_y < 0.0f || min_x >= (float)o->width || min_y >= (float)o->height)
+		return true;
+
+	int x0 = (min_x < 0.0f) ? 0 : (int)min_x;
+	int y0 = (min_y < 0.0f) ? 0 : (int)min_y;
+	int x1 = (max_x >= (float)o->width) ? (o->width - 1) : (int)max_x;
+	int y1 = (max_y >= (float)o->height) ? (o->height - 1) : (int)max_y;
+
+	// A level where the rectangle covers at most 4x4 texels
+	int l = 0;
+	while (l < o->levels - 1 && ((x1 >> l) - (x0 >> l) > 3 || (y1 >> l) - (y0 >> l) > 3))
+		l += 1;
+
+	x0 >>= l;
+	y0 >>= l;
+	x1 >>= l;
+	y1 >>= l;
+
+	for (int y = y0; y <= y1; y++)
+	{
+		for (int x = x0; x <= x1; x++)
+		{
+			if (min_z <= o->level[l][y * o->level_width[l] + x])
+				return true;
+		}
+	}
+
+	return false;
+}
+
+
+void kaOcclusionCullBoxes(const struct kaOcclusion* o, const struct kaAABBox* boxes, size_t length, uint32_t* out)
+{
+	for (size_t i = 0; i < length; i++)
+	{
+		if ((i % 32) == 0)
+			out[i / 32] = 0;
+
+		if (kaOcclusionTestBox(o, boxes[i]) == true)
+			out[i / 32] |= (uint32_t)1 << (i % 32);
+	}
+}
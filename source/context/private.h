@@ -17,7 +17,44 @@
 #define ATTRIBUTE_COLOR 11
 #define ATTRIBUTE_UV 12
 
+#define MAX_TEXTURE_UNITS 8
+
+#define ATTRIBUTE_INSTANCE_LOCAL 5 // A mat4, takes four locations
+#define ATTRIBUTE_INSTANCE_COLOR 9
+
+#define DEFAULT_ATTRIBUTES ((1u << ATTRIBUTE_POSITION) | (1u << ATTRIBUTE_COLOR) | (1u << ATTRIBUTE_UV))
+#define INSTANCE_ATTRIBUTES (0x1Fu << ATTRIBUTE_INSTANCE_LOCAL) // Local and color
+
+typedef void(APIENTRYP PFNKADRAWELEMENTSINSTANCEDPROC)(GLenum mode, GLsizei count, GLenum type, const void* indices,
+                                                        GLsizei instances);
+typedef void(APIENTRYP PFNKAVERTEXATTRIBDIVISORPROC)(GLuint index, GLuint divisor);
+typedef void(APIENTRYP PFNKAGENVERTEXARRAYSPROC)(GLsizei n, GLuint* arrays);
+typedef void(APIENTRYP PFNKABINDVERTEXARRAYPROC)(GLuint array);
+typedef void(APIENTRYP PFNKADELETEVERTEXARRAYSPROC)(GLsizei n, const GLuint* arrays);
+typedef void(APIENTRYP PFNKADRAWELEMENTSBASEVERTEXPROC)(GLenum mode, GLsizei count, GLenum type, const void* indices,
+                                                         GLint base_vertex);
+typedef void(APIENTRYP PFNKARENDERBUFFERSTORAGEMULTISAMPLEPROC)(GLenum target, GLsizei samples, GLenum format,
+                                                                 GLsizei width, GLsizei height);
+typedef void(APIENTRYP PFNKABLITFRAMEBUFFERPROC)(GLint src_x0, GLint src_y0, GLint src_x1, GLint src_y1, GLint dst_x0,
+                                                  GLint dst_y0, GLint dst_x1, GLint dst_y1, GLbitfield mask,
+                                                  GLenum filter);
+
 struct kaContext;
+struct QueueItem;
+struct QueueView;
+struct DirtyTexture;
+
+struct CommandList
+{
+	const struct kaCommandBuffer* cb;
+	int order;
+};
+
+struct QueueKey
+{
+	uint64_t key;
+	uint32_t item;
+};
 
 struct kaWindow
 {
@@ -31,6 +68,7 @@ struct kaWindow
 	bool delete_mark;
 	bool resized_mark;
 	bool is_fullscreen;
+	bool debug; // Validate objects creation, check GL errors every frame
 	uint32_t last_frame_ms;
 
 	struct jaMatrixF4 world;
@@ -39,18 +77,114 @@ struct kaWindow
 	struct jaMatrixF4 local;
 
 	const struct kaProgram* current_program;
+	const struct kaRenderTarget* current_target; // NULL for the window
 	const struct kaVertices* current_vertices;
-	const struct kaTexture* current_texture;
+	size_t current_base_vertex; // Where attributes point, emulating base vertex
+
+	const struct kaVertexLayout* current_layout; // NULL for kaVertex formats
+	const struct kaVertices* current_slots[KA_MAX_LAYOUT_SLOTS];
+
+	struct
+	{
+		const struct kaVertexArray* current; // NULL for the default one
+		GLuint element_buffer;               // Of the default one, while another is bound
+		uint32_t attributes;                 // "
+		uint32_t deletions;                  // Of buffers, as names in other objects become stale
+	} vao;
+
+	struct
+	{
+		bool enabled;
+		struct jaVectorF3 scale;
+		struct jaVectorF3 offset;
+	} dequantize; // Of current vertices, applied to local at upload, or as uniforms
+
+	struct
+	{
+		GLuint texture[MAX_TEXTURE_UNITS];
+		int active_unit;
+
+		GLuint array_buffer;
+		GLuint element_buffer;
+
+		uint32_t attributes; // Enabled arrays, a bit per location
+
+		bool blend;
+		bool depth_test;
+		bool cull_face;
+
+		struct kaRgba clear_color;
+
+	} shadow; // Of GL state, to filter redundant calls
+
+	struct
+	{
+		SDL_mutex* mutex; // Created with the first load
+		bool workers;     // Holding a reference of the shared ones
+
+		struct kaTextureLoad* pending; // To decode, first in first out
+		struct kaTextureLoad* decoded; // To upload, "
+		size_t budget;                 // In bytes, per frame
+
+	} loader;
+
+	struct kaResidency* residency; // NULL if none
+
+	bool mipmap_workers; // Holding a reference of the shared ones, since the first large texture
 
 	struct
 	{
-		GLint world;
-		GLint local;
-		GLint camera;
-		GLint camera_position;
-		GLint texture[8];
+		struct DirtyTexture* textures; // With marked regions, uploaded before the next draw
+		size_t length;
+		size_t capacity;
+	} dirty;
 
-	} uniform; // For current program
+	struct kaStatistics stats;      // Of current frame
+	struct kaStatistics last_stats; // Of previous frame
+
+	struct kaBatch* pending_batch; // With quads waiting to be drawn
+
+	struct
+	{
+		struct QueueItem* items;
+		struct QueueKey* keys;
+		struct QueueKey* temp; // For sorting
+		size_t length;
+		size_t capacity;
+
+		struct QueueView* views; // World and camera of items
+		size_t views_length;
+		size_t views_capacity;
+	} queue;
+
+	struct
+	{
+		SDL_mutex* mutex; // Workers enqueue from their threads
+		struct CommandList* lists;
+		size_t length;
+		size_t capacity;
+	} commands;
+
+	struct
+	{
+		uint32_t world;
+		uint32_t local;
+		uint32_t camera; // And camera position
+		uint32_t mvp;
+		uint32_t dequantize; // Zero being no dequantization
+	} version;           // Increments at every change, programs compare it at draw time with what they have
+
+	struct
+	{
+		struct jaMatrixF4 world_camera;
+		struct jaMatrixF4 mvp;
+		struct kaFrustum frustum; // From mvp
+
+		uint32_t world; // Versions from which above were composed
+		uint32_t camera;
+		uint32_t local;
+		uint32_t frustum_mvp;
+	} composed;
 
 	struct kaVertices default_vertices;
 	struct kaIndex default_index;
@@ -59,14 +193,105 @@ struct kaWindow
 
 	struct jaImage* temp_image;
 
+	struct
+	{
+		bool es;
+		int major;
+		int minor;
+
+		bool instanced_arrays;
+		PFNKADRAWELEMENTSINSTANCEDPROC DrawElementsInstanced;
+		PFNKAVERTEXATTRIBDIVISORPROC VertexAttribDivisor;
+
+		PFNKADRAWELEMENTSBASEVERTEXPROC DrawElementsBaseVertex; // NULL without support
+
+		bool element_index_uint;
+
+		bool vertex_array_object;
+		PFNKAGENVERTEXARRAYSPROC GenVertexArrays;
+		PFNKABINDVERTEXARRAYPROC BindVertexArray;
+		PFNKADELETEVERTEXARRAYSPROC DeleteVertexArrays;
+
+		bool etc1; // Compressed formats
+		bool etc2;
+		bool s3tc;
+		bool bptc;
+
+		bool depth24; // Renderbuffers, otherwise 16 bits
+		int max_samples;
+		PFNKARENDERBUFFERSTORAGEMULTISAMPLEPROC RenderbufferStorageMultisample; // NULL without support
+		PFNKABLITFRAMEBUFFERPROC BlitFramebuffer;                               // "
+
+	} ext; // For window context
+
 	SDL_Window* sdl_window;
 	SDL_GLContext* gl_context;
 };
 
+struct CallerState // What the caller had set, as flushes replay draws right before its own
+{
+	const struct kaProgram* program;
+	GLuint texture; // Of unit zero
+	const struct kaVertexArray* va;
+	const struct kaVertexLayout* layout;
+	const struct kaVertices* vertices;
+	const struct kaVertices* slots[KA_MAX_LAYOUT_SLOTS];
+	struct jaMatrixF4 local;
+};
+
 struct kaWindow* InternalAllocWindow();
 void InternalFreeWindow(struct kaWindow* window);
 int InternalSwitchContext(struct kaWindow* window, struct jaStatus* st);
 void InternalFocusWindow(struct kaWindow* window);
 int InternalInitGlad();
+void InternalLoadExtensions(struct kaWindow* window);
+
+void InternalBatchFlush(struct kaWindow* window);
+void InternalSetInstance(const struct kaInstance* instance);
+void InternalQueueFlush(struct kaWindow* window);
+void InternalQueueFree(struct kaWindow* window);
+int InternalCommandsInit(struct kaWindow* window);
+void InternalCommandsFlush(struct kaWindow* window);
+void InternalCommandsFree(struct kaWindow* window);
+
+void InternalUploadUniforms(struct kaWindow* window);
+const struct jaMatrixF4* InternalWorldCamera(struct kaWindow* window);
+const struct jaMatrixF4* InternalMvp(struct kaWindow* window);
+void InternalMatrixMultiply(const struct jaMatrixF4* a, const struct jaMatrixF4* b, struct jaMatrixF4* out);
+void InternalBindBuffer(struct kaWindow* window, GLenum target, GLuint glptr);
+void InternalBindTexture(struct kaWindow* window, int unit, GLuint glptr);
+void InternalEnable(struct kaWindow* window, GLenum capability, bool enable);
+void InternalAttributes(struct kaWindow* window, uint32_t mask);
+void InternalPointers(struct kaWindow* window, size_t base_vertex);
+void InternalBindVertexArray(struct kaWindow* window, const struct kaVertexArray* va);
+void InternalSaveState(const struct kaWindow* window, struct CallerState* out);
+void InternalRestoreState(struct kaWindow* window, const struct CallerState* state);
+void InternalForgetBuffer(struct kaWindow* window, GLuint glptr);
+void InternalForgetTexture(struct kaWindow* window, GLuint glptr);
+int InternalWorkersAcquire(const char* function, struct jaStatus* st);
+void InternalWorkersRelease();
+void InternalWorkersFor(void (*function)(void*), void* data);
+int InternalWorkersPost(void (*function)(void*), void* data);
+void InternalWorkersCancel(void* data);
+void InternalLoaderFlush(struct kaWindow* window);
+void InternalLoaderFree(struct kaWindow* window);
+struct kaTextureLoad* InternalTextureLoad(struct kaWindow* window, const char* filename, enum kaTextureFilter filter,
+                                          enum kaTextureWrap wrap, int reduce,
+                                          void (*callback)(struct kaWindow*, struct kaTextureLoad*, void*),
+                                          void* user_data, struct jaStatus* st);
+void InternalTextureLoadTake(struct kaTextureLoad* item, struct kaTexture* out, size_t* out_bytes);
+void InternalResidencyTouch(struct kaWindow* window, size_t id);
+void InternalResidencyUpdate(struct kaWindow* window);
+int InternalMipmaps(struct kaWindow* window, const struct jaImage* image, size_t x, size_t y, size_t width,
+                    size_t height, enum kaMipmapFilter filter, bool srgb, bool whole);
+void InternalMipmapsFree(struct kaWindow* window);
+void InternalTextureSubImage(struct kaWindow* window, const struct jaImage* image, size_t x, size_t y, size_t width,
+                             size_t height);
+void InternalDirtyFlush(struct kaWindow* window);
+void InternalDirtyForget(struct kaWindow* window, const struct kaTexture* texture, bool upload);
+void InternalDirtyFree(struct kaWindow* window);
+void InternalTextureParameters(enum kaTextureFilter filter, enum kaTextureWrap wrap, bool mipmaps);
+int InternalCheckBuffer(const struct kaWindow* window, GLenum target, GLuint glptr, size_t size, const char* function,
+                        struct jaStatus* st);
 
 #endif
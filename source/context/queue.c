@@ -0,0 +1,299 @@
+/*-----------------------------
+
+MIT License
+
+Copyright (c) 2020 Alexander Brandt
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-------------------------------
+
+ [context/queue.c]
+ - Alexander Brandt 2020
+-----------------------------*/
+
+#include "private.h"
+
+
+// Keys, from most to less significant bits:
+// - Opaque:      layer (8), translucent = 0 (1), program (10), texture (12), vertices (9), depth (24)
+// - Translucent: layer (8), translucent = 1 (1), inverted depth (24), program (10), texture (12), vertices (9)
+
+#define LAYER_SHIFT 56
+#define TRANSLUCENT_BIT ((uint64_t)1 << 55)
+
+#define MIN_CAPACITY 64
+
+
+struct QueueItem
+{
+	const struct kaProgram* program;
+	const struct kaTexture* texture;
+	const struct kaVertices* vertices;
+	const struct kaIndex* index;
+	struct jaMatrixF4 local;
+	size_t view;
+};
+
+struct QueueView // World and camera at submission, shared by consecutive items
+{
+	struct jaMatrixF4 world;
+	struct jaMatrixF4 camera;
+	struct jaVectorF3 camera_position;
+
+	uint32_t world_version;
+	uint32_t camera_version;
+};
+
+
+static inline uint64_t sDepth(const struct kaWindow* window, const struct jaMatrixF4* local)
+{
+	// Squared distance to camera, as positive floats bits sort as
+	// integers we only need to drop the sign and some precision
+	float x = local->e[3][0] - window->camera_position.x;
+	float y = local->e[3][1] - window->camera_position.y;
+	float z = local->e[3][2] - window->camera_position.z;
+	float d = x * x + y * y + z * z;
+	uint32_t bits = 0;
+
+	memcpy(&bits, &d, sizeof(uint32_t));
+	return (uint64_t)((bits & 0x7FFFFFFF) >> 7); // 24 bits
+}
+
+
+static inline uint64_t sKey(const struct kaWindow* window, int layer, bool translucent, const struct QueueItem* item)
+{
+	uint64_t l = (uint64_t)((layer < 0) ? 0 : (layer > 255) ? 255 : layer);
+	uint64_t p = (uint64_t)(item->program->glptr & 0x3FF);
+	uint64_t t = (uint64_t)(item->texture->glptr & 0xFFF);
+	uint64_t v = (uint64_t)(item->vertices->glptr & 0x1FF);
+	uint64_t d = sDepth(window, &item->local);
+
+	if (translucent == false) // Front to back, grouping state changes
+		return (l << LAYER_SHIFT) | (p << 45) | (t << 33) | (v << 24) | d;
+
+	// Back to front
+	return (l << LAYER_SHIFT) | TRANSLUCENT_BIT | ((0xFFFFFF - d) << 31) | (p << 21) | (t << 9) | v;
+}
+
+
+static int sGrow(struct kaWindow* window)
+{
+	size_t capacity = (window->queue.capacity == 0) ? MIN_CAPACITY : window->queue.capacity * 2;
+	struct QueueItem* items = NULL;
+	struct QueueKey* keys = NULL;
+	struct QueueKey* temp = NULL;
+
+	if ((items = realloc(window->queue.items, sizeof(struct QueueItem) * capacity)) == NULL)
+		return 1;
+
+	window->queue.items = items;
+
+	if ((keys = realloc(window->queue.keys, sizeof(struct QueueKey) * capacity)) == NULL)
+		return 1;
+
+	window->queue.keys = keys;
+
+	if ((temp = realloc(window->queue.temp, sizeof(struct QueueKey) * capacity)) == NULL)
+		return 1;
+
+	window->queue.temp = temp;
+	window->queue.capacity = capacity;
+	return 0;
+}
+
+
+static int sView(struct kaWindow* window)
+{
+	struct QueueView* view = NULL;
+
+	if (window->queue.views_length > 0)
+	{
+		view = window->queue.views + window->queue.views_length - 1;
+
+		if (view->world_version == window->version.world && view->camera_version == window->version.camera)
+			return 0;
+	}
+
+	if (window->queue.views_length == window->queue.views_capacity)
+	{
+		size_t capacity = (window->queue.views_capacity == 0) ? 4 : window->queue.views_capacity * 2;
+
+		if ((view = realloc(window->queue.views, sizeof(struct QueueView) * capacity)) == NULL)
+			return 1;
+
+		window->queue.views = view;
+		window->queue.views_capacity = capacity;
+	}
+
+	view = window->queue.views + window->queue.views_length;
+	view->world = window->world;
+	view->camera = window->camera;
+	view->camera_position = window->camera_position;
+	view->world_version = window->version.world;
+	view->camera_version = window->version.camera;
+
+	window->queue.views_length += 1;
+	return 0;
+}
+
+
+static void sRadixSort(struct QueueKey* keys, struct QueueKey* temp, size_t length)
+{
+	// LSD, a byte per pass
+	size_t histogram[256];
+	struct QueueKey* from = keys;
+	struct QueueKey* to = temp;
+	struct QueueKey* swap = NULL;
+
+	for (unsigned shift = 0; shift < 64; shift += 8)
+	{
+		memset(histogram, 0, sizeof(histogram));
+
+		for (size_t i = 0; i < length; i++)
+			histogram[(from[i].key >> shift) & 0xFF] += 1;
+
+		// All keys share this byte, nothing to do
+		if (histogram[(from[0].key >> shift) & 0xFF] == length)
+			continue;
+
+		for (size_t i = 0, offset = 0; i < 256; i++)
+		{
+			size_t count = histogram[i];
+			histogram[i] = offset;
+			offset += count;
+		}
+
+		for (size_t i = 0; i < length; i++)
+			to[histogram[(from[i].key >> shift) & 0xFF]++] = from[i];
+
+		swap = from;
+		from = to;
+		to = swap;
+	}
+
+	if (from != keys)
+		memcpy(keys, from, sizeof(struct QueueKey) * length);
+}
+
+
+void kaQueueDraw(struct kaWindow* window, int layer, bool translucent, const struct kaProgram* program,
+                 const struct kaTexture* texture, const struct kaVertices* vertices, const struct kaIndex* index,
+                 struct jaMatrixF4 local)
+{
+	struct QueueItem* item = NULL;
+
+	if (window == NULL)
+		return;
+
+	program = (program != NULL) ? program : &window->default_program;
+	texture = (texture != NULL) ? texture : &window->default_texture;
+	vertices = (vertices != NULL) ? vertices : &window->default_vertices;
+	index = (index != NULL) ? index : &window->default_index;
+
+	// Without memory there is no queue, draw it now
+	if ((window->queue.length == window->queue.capacity && sGrow(window) != 0) || sView(window) != 0)
+	{
+		struct jaMatrixF4 old_local = window->local;
+
+		kaSetProgram(window, program);
+		kaSetTexture(window, 0, texture);
+		kaSetVertices(window, vertices);
+		kaSetLocal(window, local);
+		kaDraw(window, index);
+		kaSetLocal(window, old_local);
+		return;
+	}
+
+	item = window->queue.items + window->queue.length;
+	item->program = program;
+	item->texture = texture;
+	item->vertices = vertices;
+	item->index = index;
+	item->local = local;
+	item->view = window->queue.views_length - 1;
+
+	window->queue.keys[window->queue.length].key = sKey(window, layer, translucent, item);
+	window->queue.keys[window->queue.length].item = (uint32_t)window->queue.length;
+	window->queue.length += 1;
+}
+
+
+void InternalQueueFlush(struct kaWindow* window)
+{
+	struct jaMatrixF4 old_local;
+	struct jaMatrixF4 old_world;
+	struct jaMatrixF4 old_camera;
+	struct jaVectorF3 old_camera_position;
+	bool old_blend = false;
+	size_t view = SIZE_MAX;
+
+	if (window->queue.length == 0)
+		return;
+
+	old_local = window->local;
+	old_world = window->world;
+	old_camera = window->camera;
+	old_camera_position = window->camera_position;
+	old_blend = window->shadow.blend;
+
+	sRadixSort(window->queue.keys, window->queue.temp, window->queue.length);
+
+	// Replay, the state shadow filters what is repeated between items
+	for (size_t i = 0; i < window->queue.length; i++)
+	{
+		const struct QueueItem* item = window->queue.items + window->queue.keys[i].item;
+
+		if (item->view != view)
+		{
+			view = item->view;
+			kaSetWorld(window, window->queue.views[view].world);
+			kaSetCameraMatrix(window, window->queue.views[view].camera, window->queue.views[view].camera_position);
+		}
+
+		kaSetBlend(window, (window->queue.keys[i].key & TRANSLUCENT_BIT) != 0); // Opaque ones sorted as such
+		kaSetProgram(window, item->program);
+		kaSetTexture(window, 0, item->texture);
+		kaSetVertices(window, item->vertices);
+		kaSetLocal(window, item->local);
+		kaDraw(window, item->index);
+	}
+
+	kaSetBlend(window, old_blend);
+	kaSetLocal(window, old_local);
+	kaSetWorld(window, old_world);
+	kaSetCameraMatrix(window, old_camera, old_camera_position);
+	window->queue.length = 0;
+	window->queue.views_length = 0;
+}
+
+
+void InternalQueueFree(struct kaWindow* window)
+{
+	if (window->queue.items != NULL)
+		free(window->queue.items);
+	if (window->queue.keys != NULL)
+		free(window->queue.keys);
+	if (window->queue.temp != NULL)
+		free(window->queue.temp);
+	if (window->queue.views != NULL)
+		free(window->queue.views);
+
+	memset(&window->queue, 0, sizeof(window->queue));
+}
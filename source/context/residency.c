@@ -0,0 +1,410 @@
+/*-----------------------------
+
+MIT License
+
+Copyright (c) 2020 Alexander Brandt
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-------------------------------
+
+ [context/residency.c]
+ - Alexander Brandt 2020
+-----------------------------*/
+
+#include "private.h"
+
+#define LEVEL_EVICTED -1
+#define MAX_REDUCE 3      // Levels dropped at most
+#define RECENT_FRAMES 120 // Used within, reduced rather than evicted
+
+struct Resident
+{
+	struct kaTexture* texture; // Of the user, NULL if slot is free
+	char* filename;
+	bool reducible; // Ktx files can't
+
+	int level;         // Dropped levels, or evicted
+	size_t bytes;      // Estimated, as level is
+	size_t bytes_full; // Zero until the first stream
+	size_t last_frame; // Bound in
+	bool failed;       // To stream, not retried
+
+	struct kaTextureLoad* load; // Stream in progress, NULL if none
+	int target;                 // Level of it
+};
+
+struct kaResidency
+{
+	struct Resident* residents;
+	size_t length;
+	size_t capacity;
+
+	struct Resident** lru; // Temporary, for sorting
+	size_t pending;        // Bytes that reductions in progress will free
+
+	struct kaResidencyStatistics stats;
+};
+
+
+static inline size_t sBytes(const struct Resident* r, int level)
+{
+	return (level == LEVEL_EVICTED) ? 0 : r->bytes_full >> (level * 2);
+}
+
+
+static int sPlaceholder(struct kaWindow* window, struct Resident* r, size_t id)
+{
+	uint8_t grey = 128;
+	struct jaImage image = {0};
+	struct jaStatus st = {0};
+
+	image.channels = 1;
+	image.format = JA_IMAGE_U8;
+	image.width = 1;
+	image.height = 1;
+	image.size = sizeof(grey);
+	image.data = &grey;
+
+	if (kaTextureInitImage(window, &image, r->texture->filter, r->texture->wrap, r->texture, &st) != 0)
+		return 1;
+
+	r->texture->residency_id = id + 1;
+	return 0;
+}
+
+
+static void sCancel(struct kaWindow* window, struct kaResidency* res, struct Resident* r)
+{
+	if (r->load == NULL)
+		return;
+
+	if (r->level != LEVEL_EVICTED && r->target > r->level)
+		res->pending -= r->bytes - sBytes(r, r->target);
+
+	kaTextureLoadDelete(window, r->load);
+	r->load = NULL;
+}
+
+
+static void sEvict(struct kaWindow* window, struct kaResidency* res, struct Resident* r)
+{
+	const size_t id = r->texture->residency_id - 1;
+
+	sCancel(window, res, r);
+	kaTextureFree(window, r->texture);
+
+	if (sPlaceholder(window, r, id) != 0)
+		r->texture->residency_id = id + 1; // Without texture, but still managed
+
+	res->stats.bytes -= r->bytes;
+	res->stats.evictions += 1;
+	r->bytes = 0;
+	r->level = LEVEL_EVICTED;
+}
+
+
+static void sLoaded(struct kaWindow* window, struct kaTextureLoad* item, void* user_data)
+{
+	struct kaResidency* res = window->residency;
+	struct Resident* r = &res->residents[(size_t)(uintptr_t)user_data];
+	const size_t id = (size_t)(uintptr_t)user_data;
+	struct kaTexture texture = {0};
+
+	if (r->level != LEVEL_EVICTED && r->target > r->level)
+		res->pending -= r->bytes - sBytes(r, r->target);
+
+	r->load = NULL;
+
+	if (kaTextureLoadState(item, NULL) == KA_LOAD_READY)
+	{
+		InternalTextureLoadTake(item, &texture, &r->bytes_full);
+
+		// Replace what was there, keeping the user structure
+		kaTextureFree(window, r->texture);
+		*r->texture = texture;
+		r->texture->residency_id = id + 1;
+
+		res->stats.bytes -= r->bytes;
+		r->level = r->target;
+		r->bytes = sBytes(r, r->level);
+		res->stats.bytes += r->bytes;
+	}
+	else
+		r->failed = true;
+
+	kaTextureLoadDelete(window, item); // Fine inside its callback
+}
+
+
+static void sStream(struct kaWindow* window, struct kaResidency* res, struct Resident* r, int target)
+{
+	struct jaStatus st = {0};
+	const size_t id = r->texture->residency_id - 1;
+
+	if ((r->load = InternalTextureLoad(window, r->filename, r->texture->filter, r->texture->wrap, target, sLoaded,
+	                                   (void*)(uintptr_t)id, &st)) == NULL)
+		return; // Retried next time is bound
+
+	r->target = target;
+
+	if (r->level != LEVEL_EVICTED && target > r->level)
+	{
+		res->pending += r->bytes - sBytes(r, target);
+		res->stats.reductions += 1;
+	}
+	else
+		res->stats.streams += 1;
+}
+
+
+void InternalResidencyTouch(struct kaWindow* window, size_t id)
+{
+	struct kaResidency* res = window->residency;
+	struct Resident* r = NULL;
+	int target = 0;
+
+	if (id >= res->length || (r = &res->residents[id])->texture == NULL)
+		return;
+
+	r->last_frame = kaGetFrame();
+
+	if (r->level == 0 || r->load != NULL || r->failed == true)
+		return;
+
+	// As much resolution as fits, unknown until the first stream
+	if (r->reducible == true && r->bytes_full != 0)
+	{
+		for (target = 0; target < MAX_REDUCE; target++)
+		{
+			if (res->stats.bytes - r->bytes + sBytes(r, target) <= res->stats.budget)
+				break;
+		}
+
+		if (r->level != LEVEL_EVICTED && target >= r->level)
+			return;
+	}
+
+	sStream(window, res, r, target);
+}
+
+
+static int sCompare(const void* a, const void* b)
+{
+	const struct Resident* ra = *(const struct Resident* const*)a;
+	const struct Resident* rb = *(const struct Resident* const*)b;
+	return (ra->last_frame > rb->last_frame) - (ra->last_frame < rb->last_frame);
+}
+
+
+void InternalResidencyUpdate(struct kaWindow* window)
+{
+	struct kaResidency* res = window->residency;
+	const size_t frame = kaGetFrame();
+	size_t candidates = 0;
+
+	if (res == NULL || res->stats.bytes - res->pending <= res->stats.budget)
+		return;
+
+	// Least recently used first, never ones of this or the previous frame
+	for (size_t i = 0; i < res->length; i++)
+	{
+		struct Resident* r = &res->residents[i];
+
+		if (r->texture != NULL && r->level != LEVEL_EVICTED && r->last_frame + 1 < frame)
+			res->lru[candidates++] = r;
+	}
+
+	qsort(res->lru, candidates, sizeof(struct Resident*), sCompare);
+
+	for (size_t i = 0; i < candidates && res->stats.bytes - res->pending > res->stats.budget; i++)
+	{
+		struct Resident* r = res->lru[i];
+
+		if (r->load != NULL) // Reducing already
+			continue;
+
+		if (frame - r->last_frame < RECENT_FRAMES && r->reducible == true && r->level < MAX_REDUCE)
+			sStream(window, res, r, r->level + 1);
+		else
+			sEvict(window, res, r);
+	}
+}
+
+
+struct kaResidency* kaResidencyCreate(struct kaWindow* window, size_t budget, struct jaStatus* st)
+{
+	struct kaResidency* res = NULL;
+
+	jaStatusSet(st, "kaResidencyCreate", JA_STATUS_SUCCESS, NULL);
+
+	if (window->residency != NULL)
+	{
+		jaStatusSet(st, "kaResidencyCreate", JA_STATUS_INVALID_ARGUMENT, "one per window");
+		return NULL;
+	}
+
+	if ((res = calloc(1, sizeof(struct kaResidency))) == NULL)
+	{
+		jaStatusSet(st, "kaResidencyCreate", JA_STATUS_MEMORY_ERROR, NULL);
+		return NULL;
+	}
+
+	res->stats.budget = budget;
+	window->residency = res;
+	return res;
+}
+
+
+void kaResidencyDelete(struct kaWindow* window, struct kaResidency* res)
+{
+	for (size_t i = 0; i < res->length; i++)
+	{
+		if (res->residents[i].texture != NULL)
+			kaResidencyRemove(window, res, res->residents[i].texture);
+	}
+
+	if (window->residency == res)
+		window->residency = NULL;
+
+	free(res->residents);
+	free(res->lru);
+	free(res);
+}
+
+
+int kaResidencyAdd(struct kaWindow* window, struct kaResidency* res, const char* filename, enum kaTextureFilter filter,
+                   enum kaTextureWrap wrap, struct kaTexture* out, struct jaStatus* st)
+{
+	struct Resident* r = NULL;
+	const size_t length = strlen(filename);
+	size_t id = 0;
+
+	jaStatusSet(st, "kaResidencyAdd", JA_STATUS_SUCCESS, NULL);
+
+	// Free slot, or a new one
+	for (id = 0; id < res->length; id++)
+	{
+		if (res->residents[id].texture == NULL)
+			break;
+	}
+
+	if (id == res->capacity)
+	{
+		const size_t capacity = (res->capacity == 0) ? 64 : res->capacity * 2; // HARDCODED
+		struct Resident* residents = realloc(res->residents, sizeof(struct Resident) * capacity);
+		struct Resident** lru = NULL;
+
+		if (residents != NULL)
+			res->residents = residents;
+
+		if (residents == NULL || (lru = realloc(res->lru, sizeof(struct Resident*) * capacity)) == NULL)
+		{
+			jaStatusSet(st, "kaResidencyAdd", JA_STATUS_MEMORY_ERROR, NULL);
+			return 1;
+		}
+
+		res->lru = lru;
+		res->capacity = capacity;
+	}
+
+	r = &res->residents[id];
+	memset(r, 0, sizeof(struct Resident));
+
+	if ((r->filename = malloc(length + 1)) == NULL)
+	{
+		jaStatusSet(st, "kaResidencyAdd", JA_STATUS_MEMORY_ERROR, NULL);
+		return 1;
+	}
+
+	memcpy(r->filename, filename, length + 1);
+	r->reducible = (length > 4 && strcmp(filename + length - 4, ".ktx") == 0) ? false : true;
+	r->level = LEVEL_EVICTED;
+
+	// Nothing loaded until bound
+	r->texture = out;
+	out->filter = filter;
+	out->wrap = wrap;
+
+	if (sPlaceholder(window, r, id) != 0)
+	{
+		jaStatusSet(st, "kaResidencyAdd", JA_STATUS_ERROR, "creating placeholder");
+		free(r->filename);
+		r->texture = NULL;
+		return 1;
+	}
+
+	if (id == res->length)
+		res->length += 1;
+
+	res->stats.textures += 1;
+	return 0;
+}
+
+
+void kaResidencyRemove(struct kaWindow* window, struct kaResidency* res, struct kaTexture* texture)
+{
+	struct Resident* r = NULL;
+
+	if (texture->residency_id == 0 || texture->residency_id > res->length)
+		return;
+
+	r = &res->residents[texture->residency_id - 1];
+
+	sCancel(window, res, r);
+	kaTextureFree(window, texture);
+	texture->residency_id = 0;
+
+	res->stats.bytes -= r->bytes;
+	res->stats.textures -= 1;
+
+	free(r->filename);
+	r->texture = NULL;
+}
+
+
+inline void kaResidencySetBudget(struct kaResidency* res, size_t budget)
+{
+	res->stats.budget = budget;
+}
+
+
+struct kaResidencyStatistics kaResidencyGetStatistics(const struct kaResidency* res)
+{
+	struct kaResidencyStatistics stats = res->stats;
+
+	stats.full = 0;
+	stats.reduced = 0;
+	stats.evicted = 0;
+
+	for (size_t i = 0; i < res->length; i++)
+	{
+		if (res->residents[i].texture == NULL)
+			continue;
+
+		if (res->residents[i].level == 0)
+			stats.full += 1;
+		else if (res->residents[i].level == LEVEL_EVICTED)
+			stats.evicted += 1;
+		else
+			stats.reduced += 1;
+	}
+
+	return stats;
+}
@@ -0,0 +1,106 @@
+/*-----------------------------
+
+MIT License
+
+Copyright (c) 2020 Alexander Brandt
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-------------------------------
+
+ [context/ring.c]
+ - Alexander Brandt 2020
+-----------------------------*/
+
+#include "private.h"
+
+
+int kaRingInitVertices(struct kaWindow* window, size_t max_length, struct kaRing* out, struct jaStatus* st)
+{
+	memset(out, 0, sizeof(struct kaRing));
+
+	if (kaVerticesInitUsage(window, NULL, max_length, KA_USAGE_STREAM, &out->vertices, st) != 0)
+		return 1;
+
+	out->capacity = max_length;
+	return 0;
+}
+
+
+int kaRingInitIndex(struct kaWindow* window, size_t max_length, struct kaRing* out, struct jaStatus* st)
+{
+	memset(out, 0, sizeof(struct kaRing));
+
+	if (kaIndexInitUsage(window, NULL, max_length, KA_USAGE_STREAM, &out->index, st) != 0)
+		return 1;
+
+	out->capacity = max_length;
+	return 0;
+}
+
+
+void kaRingFree(struct kaWindow* window, struct kaRing* ring)
+{
+	kaVerticesFree(window, &ring->vertices);
+	kaIndexFree(window, &ring->index);
+	memset(ring, 0, sizeof(struct kaRing));
+}
+
+
+static int sPush(struct kaWindow* window, struct kaRing* ring, GLenum target, GLuint glptr, size_t size,
+                 const void* data, size_t length, size_t* out_first)
+{
+	GLuint old_bind = (target == GL_ARRAY_BUFFER) ? window->shadow.array_buffer : window->shadow.element_buffer;
+
+	if (glptr == 0 || data == NULL || length == 0 || length > ring->capacity)
+		return 1;
+
+	InternalBindBuffer(window, target, glptr);
+
+	// Wrap around into new storage, draws issued keep the old one
+	// until they finish, so no one waits for the other
+	if (ring->cursor + length > ring->capacity)
+	{
+		glBufferData(target, (GLsizeiptr)(size * ring->capacity), NULL, GL_STREAM_DRAW);
+		ring->cursor = 0;
+	}
+
+	glBufferSubData(target, (GLintptr)(size * ring->cursor), (GLsizeiptr)(size * length), data);
+	InternalBindBuffer(window, target, old_bind);
+
+	*out_first = ring->cursor;
+	ring->cursor += length;
+	return 0;
+}
+
+
+int kaRingPushVertices(struct kaWindow* window, struct kaRing* ring, const struct kaVertex* data, size_t length,
+                       size_t* out_base_vertex)
+{
+	return sPush(window, ring, GL_ARRAY_BUFFER, ring->vertices.glptr, sizeof(struct kaVertex), data, length,
+	             out_base_vertex);
+}
+
+
+int kaRingPushIndex(struct kaWindow* window, struct kaRing* ring, const uint16_t* data, size_t length,
+                    size_t* out_first_index)
+{
+	return sPush(window, ring, GL_ELEMENT_ARRAY_BUFFER, ring->index.glptr, sizeof(uint16_t), data, length,
+	             out_first_index);
+}
@@ -31,6 +31,276 @@ SOFTWARE.
 #include "private.h"
 
 
+static const struct kaInstance s_default_instance = {
+    .local = {{{1.0f, 0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 0.0f, 1.0f}}},
+    .color = {1.0f, 1.0f, 1.0f, 1.0f}};
+
+
+inline void InternalBindBuffer(struct kaWindow* window, GLenum target, GLuint glptr)
+{
+	GLuint* shadow = (target == GL_ARRAY_BUFFER) ? &window->shadow.array_buffer : &window->shadow.element_buffer;
+
+	if (*shadow == glptr)
+	{
+		window->stats.redundant_state_changes += 1;
+		return;
+	}
+
+	*shadow = glptr;
+	glBindBuffer(target, glptr);
+	window->stats.state_changes += 1;
+}
+
+
+inline void InternalBindTexture(struct kaWindow* window, int unit, GLuint glptr)
+{
+	if (window->shadow.texture[unit] == glptr)
+	{
+		window->stats.redundant_state_changes += 1;
+		return;
+	}
+
+	if (window->shadow.active_unit != unit)
+	{
+		window->shadow.active_unit = unit;
+		glActiveTexture((GLenum)(GL_TEXTURE0 + unit));
+		window->stats.state_changes += 1;
+	}
+
+	window->shadow.texture[unit] = glptr;
+	glBindTexture(GL_TEXTURE_2D, glptr);
+	window->stats.state_changes += 1;
+}
+
+
+inline void InternalEnable(struct kaWindow* window, GLenum capability, bool enable)
+{
+	bool* shadow = NULL;
+
+	switch (capability)
+	{
+	case GL_BLEND: shadow = &window->shadow.blend; break;
+	case GL_DEPTH_TEST: shadow = &window->shadow.depth_test; break;
+	case GL_CULL_FACE: shadow = &window->shadow.cull_face; break;
+	default: return;
+	}
+
+	if (*shadow == enable)
+	{
+		window->stats.redundant_state_changes += 1;
+		return;
+	}
+
+	*shadow = enable;
+	window->stats.state_changes += 1;
+
+	if (enable == true)
+		glEnable(capability);
+	else
+		glDisable(capability);
+}
+
+
+inline void InternalAttributes(struct kaWindow* window, uint32_t mask)
+{
+	const uint32_t changed = window->shadow.attributes ^ mask;
+
+	if (changed == 0)
+	{
+		window->stats.redundant_state_changes += 1;
+		return;
+	}
+
+	for (GLuint i = 0; i < 32; i++)
+	{
+		if ((changed & ((uint32_t)1 << i)) == 0)
+			continue;
+
+		if ((mask & ((uint32_t)1 << i)) != 0)
+			glEnableVertexAttribArray(i);
+		else
+			glDisableVertexAttribArray(i);
+
+		window->stats.state_changes += 1;
+	}
+
+	window->shadow.attributes = mask;
+}
+
+
+inline void InternalForgetBuffer(struct kaWindow* window, GLuint glptr)
+{
+	// Deleted objects are unbound by GL itself
+	if (window->shadow.array_buffer == glptr)
+		window->shadow.array_buffer = 0;
+	if (window->shadow.element_buffer == glptr)
+		window->shadow.element_buffer = 0;
+
+	// Except from vertex arrays not bound, forcing a bind there is enough
+	// to not confuse it with a new buffer that takes the same name
+	if (window->vao.element_buffer == glptr)
+		window->vao.element_buffer = 0;
+
+	// Objects of kaVertexArray are not tracked, those compare this
+	window->vao.deletions += 1;
+}
+
+
+inline void InternalForgetTexture(struct kaWindow* window, GLuint glptr)
+{
+	for (int i = 0; i < MAX_TEXTURE_UNITS; i++)
+	{
+		if (window->shadow.texture[i] == glptr)
+			window->shadow.texture[i] = 0;
+	}
+}
+
+
+static inline void sApplyDequantize(const struct kaWindow* window, const struct kaProgram* program,
+                                    const struct jaMatrixF4* m, struct jaMatrixF4* out)
+{
+	// As 'm * translation(offset) * scale(scale)'
+	*out = *m;
+
+	if (window->dequantize.enabled == false || program->uniform.dequantize_scale != -1)
+		return;
+
+	const struct jaVectorF3 s = window->dequantize.scale;
+	const struct jaVectorF3 o = window->dequantize.offset;
+
+	for (int row = 0; row < 4; row++)
+	{
+		out->e[3][row] = m->e[0][row] * o.x + m->e[1][row] * o.y + m->e[2][row] * o.z + m->e[3][row];
+		out->e[0][row] = m->e[0][row] * s.x;
+		out->e[1][row] = m->e[1][row] * s.y;
+		out->e[2][row] = m->e[2][row] * s.z;
+	}
+}
+
+
+inline void InternalUploadUniforms(struct kaWindow* window)
+{
+	// Cast, the cache is mutable
+	struct kaProgram* program = (struct kaProgram*)window->current_program;
+
+	if (program == NULL)
+		return;
+
+	// Only what changed since the program was used for last time
+	if (program->uploaded.world != window->version.world)
+	{
+		program->uploaded.world = window->version.world;
+
+		if (program->uniform.world != -1)
+		{
+			glUniformMatrix4fv(program->uniform.world, 1, GL_FALSE, &window->world.e[0][0]);
+			window->stats.uniform_uploads += 1;
+		}
+	}
+
+	if (program->uploaded.local != window->version.local)
+	{
+		program->uploaded.local = window->version.local;
+
+		if (program->uniform.local != -1)
+		{
+			struct jaMatrixF4 local;
+			sApplyDequantize(window, program, &window->local, &local);
+			glUniformMatrix4fv(program->uniform.local, 1, GL_FALSE, &local.e[0][0]);
+			window->stats.uniform_uploads += 1;
+		}
+	}
+
+	if (program->uploaded.camera != window->version.camera)
+	{
+		program->uploaded.camera = window->version.camera;
+
+		if (program->uniform.camera != -1)
+		{
+			glUniformMatrix4fv(program->uniform.camera, 1, GL_FALSE, &window->camera.e[0][0]);
+			window->stats.uniform_uploads += 1;
+		}
+
+		if (program->uniform.camera_position != -1)
+		{
+			glUniform3fv(program->uniform.camera_position, 1, (float*)&window->camera_position);
+			window->stats.uniform_uploads += 1;
+		}
+	}
+
+	if (program->uniform.mvp != -1)
+	{
+		const struct jaMatrixF4* mvp = InternalMvp(window);
+
+		if (program->uploaded.mvp != window->version.mvp)
+		{
+			struct jaMatrixF4 temp;
+			sApplyDequantize(window, program, mvp, &temp);
+
+			program->uploaded.mvp = window->version.mvp;
+			glUniformMatrix4fv(program->uniform.mvp, 1, GL_FALSE, &temp.e[0][0]);
+			window->stats.uniform_uploads += 1;
+		}
+	}
+
+	if (program->uniform.dequantize_scale != -1 && program->uploaded.dequantize != window->version.dequantize)
+	{
+		const bool enabled = window->dequantize.enabled;
+
+		program->uploaded.dequantize = window->version.dequantize;
+		glUniform3f(program->uniform.dequantize_scale, (enabled == true) ? window->dequantize.scale.x : 1.0f,
+		            (enabled == true) ? window->dequantize.scale.y : 1.0f,
+		            (enabled == true) ? window->dequantize.scale.z : 1.0f);
+		glUniform3f(program->uniform.dequantize_offset, (enabled == true) ? window->dequantize.offset.x : 0.0f,
+		            (enabled == true) ? window->dequantize.offset.y : 0.0f,
+		            (enabled == true) ? window->dequantize.offset.z : 0.0f);
+		window->stats.uniform_uploads += 2;
+	}
+}
+
+
+const struct jaMatrixF4* InternalWorldCamera(struct kaWindow* window)
+{
+	if (window->composed.world != window->version.world || window->composed.camera != window->version.camera)
+	{
+		InternalMatrixMultiply(&window->world, &window->camera, &window->composed.world_camera);
+		window->composed.world = window->version.world;
+		window->composed.camera = window->version.camera;
+
+		// Invalidates the mvp, composed from this
+		window->composed.local = window->version.local - 1;
+	}
+
+	return &window->composed.world_camera;
+}
+
+
+const struct jaMatrixF4* InternalMvp(struct kaWindow* window)
+{
+	// Composed once per change, no matter how many programs use it
+	const struct jaMatrixF4* world_camera = InternalWorldCamera(window);
+
+	if (window->composed.local != window->version.local)
+	{
+		InternalMatrixMultiply(world_camera, &window->local, &window->composed.mvp);
+		window->composed.local = window->version.local;
+		window->version.mvp += 1;
+	}
+
+	return &window->composed.mvp;
+}
+
+
+static inline void sMarkDirty(struct kaWindow* window, uint32_t* version, uint32_t uploaded)
+{
+	// A value changing again before any draw, saving us an upload
+	if (window->current_program != NULL && uploaded != *version)
+		window->stats.avoided_uniform_uploads += 1;
+
+	*version += 1;
+}
+
+
 void kaSetProgram(struct kaWindow* window, const struct kaProgram* program)
 {
 	if (window == NULL || program == NULL)
@@ -38,37 +308,189 @@ void kaSetProgram(struct kaWindow* window, const struct kaProgram* program)
 
 	if (program != window->current_program)
 	{
+		InternalBatchFlush(window);
 		window->current_program = program;
 
-		window->uniform.world = glGetUniformLocation(program->glptr, "world");
-		window->uniform.local = glGetUniformLocation(program->glptr, "local");
-		window->uniform.camera = glGetUniformLocation(program->glptr, "camera");
-		window->uniform.camera_position = glGetUniformLocation(program->glptr, "camera_position");
+		glUseProgram(program->glptr);
+		window->stats.state_changes += 1;
+	}
+	else
+		window->stats.redundant_state_changes += 1;
+}
 
-		window->uniform.texture[0] = glGetUniformLocation(program->glptr, "texture0");
-		window->uniform.texture[1] = glGetUniformLocation(program->glptr, "texture1");
-		window->uniform.texture[2] = glGetUniformLocation(program->glptr, "texture2");
-		window->uniform.texture[3] = glGetUniformLocation(program->glptr, "texture3");
-		window->uniform.texture[4] = glGetUniformLocation(program->glptr, "texture4");
-		window->uniform.texture[5] = glGetUniformLocation(program->glptr, "texture5");
-		window->uniform.texture[6] = glGetUniformLocation(program->glptr, "texture6");
-		window->uniform.texture[7] = glGetUniformLocation(program->glptr, "texture7");
 
-		glUseProgram(program->glptr);
+static void sDequantize(struct kaWindow* window, const struct kaVertices* vertices)
+{
+	const bool enabled = (vertices->format == KA_VERTEX_QUANTIZED) ? true : false;
+
+	if (enabled == false && window->dequantize.enabled == false)
+		return;
+
+	if (enabled == true && window->dequantize.enabled == true &&
+	    memcmp(&vertices->scale, &window->dequantize.scale, sizeof(struct jaVectorF3)) == 0 &&
+	    memcmp(&vertices->offset, &window->dequantize.offset, sizeof(struct jaVectorF3)) == 0)
+		return;
+
+	// Lives in local, so this is a local change
+	InternalBatchFlush(window);
+	window->dequantize.enabled = enabled;
+	window->dequantize.scale = vertices->scale;
+	window->dequantize.offset = vertices->offset;
+	sMarkDirty(window, &window->version.local,
+	           (window->current_program != NULL) ? window->current_program->uploaded.local : 0);
+	window->version.dequantize += 1;
+}
 
-		glUniformMatrix4fv(window->uniform.world, 1, GL_FALSE, &window->world.e[0][0]);
-		glUniformMatrix4fv(window->uniform.local, 1, GL_FALSE, &window->local.e[0][0]);
-		glUniformMatrix4fv(window->uniform.camera, 1, GL_FALSE, &window->camera.e[0][0]);
-		glUniform3fv(window->uniform.camera_position, 1, (float*)&window->camera_position);
-		glUniform1i(window->uniform.texture[0], 0);
-		glUniform1i(window->uniform.texture[1], 1);
-		glUniform1i(window->uniform.texture[2], 2);
-		glUniform1i(window->uniform.texture[3], 3);
-		glUniform1i(window->uniform.texture[4], 4);
-		glUniform1i(window->uniform.texture[5], 5);
-		glUniform1i(window->uniform.texture[6], 6);
-		glUniform1i(window->uniform.texture[7], 7);
+
+static void sLayoutAttributes(struct kaWindow* window, size_t base_vertex)
+{
+	const struct kaVertexLayout* layout = window->current_layout;
+
+	for (size_t i = 0; i < layout->length; i++)
+	{
+		const struct kaAttribute* a = &layout->attribute[i];
+		const uint8_t* offset = ((const uint8_t*)NULL) + a->offset + a->stride * base_vertex;
+
+		InternalBindBuffer(window, GL_ARRAY_BUFFER, window->current_slots[a->slot]->glptr);
+		glVertexAttribPointer((GLuint)i, a->components, layout->gl_type[i],
+		                      (a->normalized == true) ? GL_TRUE : GL_FALSE, (GLsizei)a->stride, offset);
 	}
+
+	window->stats.state_changes += layout->length;
+	window->current_base_vertex = base_vertex;
+}
+
+
+void InternalPointers(struct kaWindow* window, size_t base_vertex)
+{
+	const struct kaVertices* vertices = window->current_vertices;
+
+	if (window->current_layout != NULL)
+	{
+		sLayoutAttributes(window, base_vertex);
+		return;
+	}
+
+	InternalBindBuffer(window, GL_ARRAY_BUFFER, vertices->glptr);
+
+	switch (vertices->format)
+	{
+	case KA_VERTEX_FLOAT:
+	{
+		const struct kaVertex* base = ((const struct kaVertex*)NULL) + base_vertex;
+		glVertexAttribPointer(ATTRIBUTE_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(struct kaVertex), &base->position);
+		glVertexAttribPointer(ATTRIBUTE_COLOR, 4, GL_FLOAT, GL_FALSE, sizeof(struct kaVertex), &base->color);
+		glVertexAttribPointer(ATTRIBUTE_UV, 2, GL_FLOAT, GL_FALSE, sizeof(struct kaVertex), &base->uv);
+		break;
+	}
+	case KA_VERTEX_COMPACT:
+	{
+		const struct kaVertexCompact* base = ((const struct kaVertexCompact*)NULL) + base_vertex;
+		const GLsizei stride = sizeof(struct kaVertexCompact);
+		glVertexAttribPointer(ATTRIBUTE_POSITION, 3, GL_FLOAT, GL_FALSE, stride, &base->position);
+		glVertexAttribPointer(ATTRIBUTE_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, base->color);
+		glVertexAttribPointer(ATTRIBUTE_UV, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, base->uv);
+		break;
+	}
+	case KA_VERTEX_QUANTIZED:
+	{
+		const struct kaVertexQuantized* base = ((const struct kaVertexQuantized*)NULL) + base_vertex;
+		const GLsizei stride = sizeof(struct kaVertexQuantized);
+		glVertexAttribPointer(ATTRIBUTE_POSITION, 3, GL_SHORT, GL_TRUE, stride, base->position);
+		glVertexAttribPointer(ATTRIBUTE_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, base->color);
+		glVertexAttribPointer(ATTRIBUTE_UV, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, base->uv);
+		break;
+	}
+	default: break; // KA_VERTEX_LAYOUT, only through kaSetVerticesLayout()
+	}
+
+	window->stats.state_changes += 3;
+	window->current_base_vertex = base_vertex;
+}
+
+
+static inline void sBaseVertex(struct kaWindow* window, size_t base_vertex)
+{
+	// Emulated moving where attributes point
+	if (window->current_vertices != NULL && window->current_base_vertex != base_vertex)
+		InternalPointers(window, base_vertex);
+}
+
+
+void InternalBindVertexArray(struct kaWindow* window, const struct kaVertexArray* va)
+{
+	// Cast, the cache is mutable
+	struct kaVertexArray* prev = (struct kaVertexArray*)window->vao.current;
+
+	if (va == prev)
+	{
+		window->stats.redundant_state_changes += 1;
+		return;
+	}
+
+	// Element buffer and enabled arrays belong to the object, save them for when it comes back
+	if (prev == NULL)
+	{
+		window->vao.element_buffer = window->shadow.element_buffer;
+		window->vao.attributes = window->shadow.attributes;
+	}
+	else
+	{
+		prev->bound.element_buffer = window->shadow.element_buffer;
+		prev->bound.attributes = window->shadow.attributes;
+		prev->bound.base_vertex = window->current_base_vertex;
+		prev->bound.deletions = window->vao.deletions;
+	}
+
+	window->ext.BindVertexArray((va != NULL) ? va->glptr : 0);
+	window->stats.state_changes += 1;
+	window->vao.current = va;
+
+	memset(window->current_slots, 0, sizeof(window->current_slots));
+
+	if (va != NULL)
+	{
+		window->shadow.element_buffer = (va->bound.deletions == window->vao.deletions) ? va->bound.element_buffer : 0;
+		window->shadow.attributes = va->bound.attributes;
+		window->current_base_vertex = va->bound.base_vertex;
+		window->current_vertices = (va->layout != NULL) ? va->slots[0] : va->vertices;
+		window->current_layout = va->layout;
+
+		if (va->layout != NULL)
+			memcpy(window->current_slots, va->slots, sizeof(window->current_slots));
+	}
+	else
+	{
+		// Pointers in the default object are unknown, next kaSetVertices() sets them
+		window->shadow.element_buffer = window->vao.element_buffer;
+		window->shadow.attributes = window->vao.attributes;
+		window->current_base_vertex = 0;
+		window->current_vertices = NULL;
+		window->current_layout = NULL;
+	}
+}
+
+
+void kaSetVertexArray(struct kaWindow* window, const struct kaVertexArray* va)
+{
+	if (window == NULL || va == NULL)
+		return;
+
+	InternalBatchFlush(window); // Pending quads use current vertices
+
+	// Emulated
+	if (va->glptr == 0)
+	{
+		if (va->layout != NULL)
+			kaSetVerticesLayout(window, va->layout, va->slots);
+		else
+			kaSetVertices(window, va->vertices);
+
+		return;
+	}
+
+	InternalBindVertexArray(window, va);
+	sDequantize(window, window->current_vertices);
 }
 
 
@@ -77,30 +499,72 @@ inline void kaSetVertices(struct kaWindow* window, const struct kaVertices* vert
 	if (window == NULL || vertices == NULL)
 		return;
 
-	if (vertices != window->current_vertices)
+	InternalBatchFlush(window); // Pending quads use current vertices
+
+	if (window->vao.current != NULL)
+		InternalBindVertexArray(window, NULL);
+
+	if (vertices != window->current_vertices || window->current_base_vertex != 0 || window->current_layout != NULL)
 	{
+		window->current_layout = NULL;
 		window->current_vertices = vertices;
-
-		glBindBuffer(GL_ARRAY_BUFFER, vertices->glptr);
-		glVertexAttribPointer(ATTRIBUTE_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(struct kaVertex), NULL);
-		glVertexAttribPointer(ATTRIBUTE_COLOR, 4, GL_FLOAT, GL_FALSE, sizeof(struct kaVertex), ((float*)NULL) + 3);
-		glVertexAttribPointer(ATTRIBUTE_UV, 2, GL_FLOAT, GL_FALSE, sizeof(struct kaVertex), ((float*)NULL) + 7);
+		InternalAttributes(window, DEFAULT_ATTRIBUTES);
+		InternalPointers(window, 0);
+		sDequantize(window, vertices);
 	}
+	else
+		window->stats.redundant_state_changes += 1;
 }
 
 
-inline void kaSetTexture(struct kaWindow* window, int unit, const struct kaTexture* texture)
+void kaSetVerticesLayout(struct kaWindow* window, const struct kaVertexLayout* layout,
+                         const struct kaVertices* const* slots)
 {
-	if (window == NULL || texture == NULL)
+	if (window == NULL || layout == NULL || slots == NULL)
 		return;
 
-	if (texture != window->current_texture)
+	for (int i = 0; i < layout->slots; i++)
 	{
-		window->current_texture = texture;
+		if (slots[i] == NULL)
+			return;
+	}
 
-		glActiveTexture((GLenum)(GL_TEXTURE0 + unit));
-		glBindTexture(GL_TEXTURE_2D, texture->glptr);
+	InternalBatchFlush(window); // Pending quads use current vertices
+
+	if (window->vao.current != NULL)
+		InternalBindVertexArray(window, NULL);
+
+	// Same layout and buffers, pointers already set
+	if (layout == window->current_layout && window->current_base_vertex == 0 &&
+	    memcmp(window->current_slots, slots, sizeof(struct kaVertices*) * (size_t)layout->slots) == 0)
+	{
+		window->stats.redundant_state_changes += 1;
+		return;
 	}
+
+	memset(window->current_slots, 0, sizeof(window->current_slots));
+	memcpy(window->current_slots, slots, sizeof(struct kaVertices*) * (size_t)layout->slots);
+
+	window->current_layout = layout;
+	window->current_vertices = slots[0];
+	InternalAttributes(window, layout->mask);
+	InternalPointers(window, 0);
+	sDequantize(window, slots[0]);
+}
+
+
+inline void kaSetTexture(struct kaWindow* window, int unit, const struct kaTexture* texture)
+{
+	if (window == NULL || texture == NULL || unit < 0 || unit >= MAX_TEXTURE_UNITS)
+		return;
+
+	if (texture->residency_id != 0 && window->residency != NULL)
+		InternalResidencyTouch(window, texture->residency_id - 1);
+
+	if (texture->glptr != window->shadow.texture[unit])
+		InternalBatchFlush(window);
+
+	InternalBindTexture(window, unit, texture->glptr);
 }
 
 
@@ -109,10 +573,10 @@ inline void kaSetWorld(struct kaWindow* window, struct jaMatrixF4 matrix)
 	if (window == NULL)
 		return;
 
+	InternalBatchFlush(window);
 	memcpy(&window->world, &matrix, sizeof(struct jaMatrixF4));
-
-	if (window->current_program != NULL)
-		glUniformMatrix4fv(window->uniform.world, 1, GL_FALSE, &window->world.e[0][0]);
+	sMarkDirty(window, &window->version.world,
+	           (window->current_program != NULL) ? window->current_program->uploaded.world : 0);
 }
 
 
@@ -121,14 +585,11 @@ inline void kaSetCameraLookAt(struct kaWindow* window, struct jaVectorF3 target,
 	if (window == NULL)
 		return;
 
+	InternalBatchFlush(window);
 	window->camera_position = origin;
 	window->camera = jaMatrixLookAtF4(origin, target, (struct jaVectorF3){0.0f, 0.0f, 1.0f});
-
-	if (window->current_program != NULL)
-	{
-		glUniformMatrix4fv(window->uniform.camera, 1, GL_FALSE, &window->camera.e[0][0]);
-		glUniform3fv(window->uniform.camera_position, 1, (float*)&window->camera_position);
-	}
+	sMarkDirty(window, &window->version.camera,
+	           (window->current_program != NULL) ? window->current_program->uploaded.camera : 0);
 }
 
 
@@ -137,14 +598,11 @@ inline void kaSetCameraMatrix(struct kaWindow* window, struct jaMatrixF4 matrix,
 	if (window == NULL)
 		return;
 
+	InternalBatchFlush(window);
 	window->camera_position = origin;
 	window->camera = matrix;
-
-	if (window->current_program != NULL)
-	{
-		glUniformMatrix4fv(window->uniform.camera, 1, GL_FALSE, &window->camera.e[0][0]);
-		glUniform3fv(window->uniform.camera_position, 1, (float*)&window->camera_position);
-	}
+	sMarkDirty(window, &window->version.camera,
+	           (window->current_program != NULL) ? window->current_program->uploaded.camera : 0);
 }
 
 
@@ -154,36 +612,270 @@ inline void kaSetLocal(struct kaWindow* window, struct jaMatrixF4 matrix)
 		return;
 
 	memcpy(&window->local, &matrix, sizeof(struct jaMatrixF4));
+	sMarkDirty(window, &window->version.local,
+	           (window->current_program != NULL) ? window->current_program->uploaded.local : 0);
+}
+
 
-	if (window->current_program != NULL)
-		glUniformMatrix4fv(window->uniform.local, 1, GL_FALSE, &window->local.e[0][0]);
+void InternalSaveState(const struct kaWindow* window, struct CallerState* out)
+{
+	out->program = window->current_program;
+	out->texture = window->shadow.texture[0];
+	out->va = window->vao.current;
+	out->layout = window->current_layout;
+	out->vertices = window->current_vertices;
+	out->local = window->local;
+	memcpy(out->slots, window->current_slots, sizeof(out->slots));
+}
+
+
+void InternalRestoreState(struct kaWindow* window, const struct CallerState* state)
+{
+	kaSetLocal(window, state->local);
+
+	if (state->program != NULL)
+		kaSetProgram(window, state->program);
+
+	InternalBindTexture(window, 0, state->texture);
+
+	if (state->va != NULL)
+		kaSetVertexArray(window, state->va);
+	else if (state->layout != NULL)
+		kaSetVerticesLayout(window, state->layout, state->slots);
+	else if (state->vertices != NULL)
+		kaSetVertices(window, state->vertices);
 }
 
 
 inline void kaSetCleanColor(struct kaWindow* window, struct kaRgb color)
 {
-	(void)window;
+	struct kaRgba* shadow = NULL;
+
+	if (window == NULL)
+		return;
+
+	shadow = &window->shadow.clear_color;
+
+	if (shadow->r == color.r && shadow->g == color.g && shadow->b == color.b && shadow->a == 1.0f)
+	{
+		window->stats.redundant_state_changes += 1;
+		return;
+	}
+
+	*shadow = (struct kaRgba){color.r, color.g, color.b, 1.0f};
 	glClearColor(color.r, color.g, color.b, 1.0f);
+	window->stats.state_changes += 1;
 }
 
 
-inline void kaDraw(struct kaWindow* window, const struct kaIndex* index)
+inline void kaSetBlend(struct kaWindow* window, bool enable)
 {
-	(void)window;
+	if (window != NULL)
+	{
+		if (window->shadow.blend != enable)
+			InternalBatchFlush(window);
 
-	if (index != NULL)
+		InternalEnable(window, GL_BLEND, enable);
+	}
+}
+
+
+inline void kaSetDepthTest(struct kaWindow* window, bool enable)
+{
+	if (window != NULL)
+	{
+		if (window->shadow.depth_test != enable)
+			InternalBatchFlush(window);
+
+		InternalEnable(window, GL_DEPTH_TEST, enable);
+	}
+}
+
+
+inline void kaSetCullFace(struct kaWindow* window, bool enable)
+{
+	if (window != NULL)
 	{
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index->glptr);
-		glDrawElements(GL_TRIANGLES, (GLsizei)index->length, GL_UNSIGNED_SHORT, NULL);
+		if (window->shadow.cull_face != enable)
+			InternalBatchFlush(window);
+
+		InternalEnable(window, GL_CULL_FACE, enable);
 	}
 }
 
 
+inline void kaGetStatistics(const struct kaWindow* window, struct kaStatistics* out)
+{
+	if (window != NULL && out != NULL)
+		*out = window->last_stats;
+}
+
+
+inline void kaDraw(struct kaWindow* window, const struct kaIndex* index)
+{
+	if (index != NULL)
+		kaDrawRange(window, index, 0, index->length, 0);
+}
+
+
 inline void kaDrawDefault(struct kaWindow* window)
 {
 	if (window != NULL)
+		kaDrawRange(window, &window->default_index, 0, window->default_index.length, 0);
+}
+
+
+void kaDrawRange(struct kaWindow* window, const struct kaIndex* index, size_t first, size_t count,
+                 size_t base_vertex)
+{
+	if (window == NULL || index == NULL || first >= index->length)
+		return;
+
+	if (count > index->length - first)
+		count = index->length - first;
+
+	if (count == 0)
+		return;
+
+	const GLenum type = (index->format == KA_INDEX_32) ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+	const uint8_t* offset = ((const uint8_t*)NULL) + first * ((index->format == KA_INDEX_32) ? 4 : 2);
+
+	InternalBatchFlush(window);
+	InternalBindBuffer(window, GL_ELEMENT_ARRAY_BUFFER, index->glptr);
+	InternalDirtyFlush(window);
+	InternalUploadUniforms(window);
+
+	if (base_vertex != 0 && window->ext.DrawElementsBaseVertex != NULL)
 	{
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, window->default_index.glptr);
-		glDrawElements(GL_TRIANGLES, (GLsizei)window->default_index.length, GL_UNSIGNED_SHORT, NULL);
+		window->ext.DrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)count, type, offset, (GLint)base_vertex);
 	}
+	else
+	{
+		sBaseVertex(window, base_vertex);
+		glDrawElements(GL_TRIANGLES, (GLsizei)count, type, offset);
+	}
+
+	window->stats.draws += 1;
+}
+
+
+void kaDrawCulled(struct kaWindow* window, const struct kaIndex* index, struct kaAABBox bounds)
+{
+	if (window == NULL)
+		return;
+
+	// Planes in the vertices space, so bounds don't need a transformation
+	const struct jaMatrixF4* mvp = InternalMvp(window);
+
+	if (window->composed.frustum_mvp != window->version.mvp)
+	{
+		window->composed.frustum = kaFrustumFromMatrix(*mvp);
+		window->composed.frustum_mvp = window->version.mvp;
+	}
+
+	if (kaFrustumTestBox(&window->composed.frustum, bounds) == false)
+	{
+		window->stats.culled += 1;
+		return;
+	}
+
+	if (index != NULL)
+		kaDraw(window, index);
+	else
+		kaDrawDefault(window);
+}
+
+
+void kaGetFrustum(struct kaWindow* window, struct kaFrustum* out)
+{
+	*out = kaFrustumFromMatrix(*InternalWorldCamera(window));
+}
+
+
+inline void InternalSetInstance(const struct kaInstance* instance)
+{
+	// As constant attributes, what disabled arrays read
+	if (instance == NULL)
+		instance = &s_default_instance;
+
+	glVertexAttrib4fv(ATTRIBUTE_INSTANCE_LOCAL + 0, instance->local.e[0]);
+	glVertexAttrib4fv(ATTRIBUTE_INSTANCE_LOCAL + 1, instance->local.e[1]);
+	glVertexAttrib4fv(ATTRIBUTE_INSTANCE_LOCAL + 2, instance->local.e[2]);
+	glVertexAttrib4fv(ATTRIBUTE_INSTANCE_LOCAL + 3, instance->local.e[3]);
+	glVertexAttrib4fv(ATTRIBUTE_INSTANCE_COLOR, (const float*)&instance->color);
+}
+
+
+void kaDrawInstanced(struct kaWindow* window, const struct kaIndex* index, const struct kaInstances* instances,
+                     size_t count)
+{
+	if (window == NULL || index == NULL || instances == NULL)
+		return;
+
+	if (count > instances->length)
+		count = instances->length;
+
+	if (count == 0)
+		return;
+
+	InternalBatchFlush(window);
+
+	// Dequantization folded in local would happen after 'instance_local'
+	if (window->dequantize.enabled == true &&
+	    (window->current_program == NULL || window->current_program->uniform.dequantize_scale == -1))
+		return;
+
+	InternalBindBuffer(window, GL_ELEMENT_ARRAY_BUFFER, index->glptr);
+	InternalDirtyFlush(window);
+	InternalUploadUniforms(window);
+	sBaseVertex(window, 0);
+
+	const GLenum type = (index->format == KA_INDEX_32) ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+
+	// Emulated, one draw per instance but without touching uniforms
+	if (instances->copy != NULL)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			InternalSetInstance(&instances->copy[i]);
+			glDrawElements(GL_TRIANGLES, (GLsizei)index->length, type, NULL);
+		}
+
+		window->stats.draws += count;
+
+		InternalSetInstance(NULL);
+		return;
+	}
+
+	// Hardware instancing, arrays through the shadow as vertex arrays keep them
+	const uint32_t old_attributes = window->shadow.attributes;
+	InternalAttributes(window, old_attributes | INSTANCE_ATTRIBUTES);
+	InternalBindBuffer(window, GL_ARRAY_BUFFER, instances->glptr);
+
+	for (GLuint i = 0; i < 4; i++)
+	{
+		glVertexAttribPointer(ATTRIBUTE_INSTANCE_LOCAL + i, 4, GL_FLOAT, GL_FALSE, sizeof(struct kaInstance),
+		                      ((float*)NULL) + 4 * i);
+		window->ext.VertexAttribDivisor(ATTRIBUTE_INSTANCE_LOCAL + i, 1);
+	}
+
+	glVertexAttribPointer(ATTRIBUTE_INSTANCE_COLOR, 4, GL_FLOAT, GL_FALSE, sizeof(struct kaInstance),
+	                      ((float*)NULL) + 16);
+	window->ext.VertexAttribDivisor(ATTRIBUTE_INSTANCE_COLOR, 1);
+
+	window->ext.DrawElementsInstanced(GL_TRIANGLES, (GLsizei)index->length, type, NULL, (GLsizei)count);
+	window->stats.draws += 1;
+
+	for (GLuint i = 0; i < 5; i++)
+		window->ext.VertexAttribDivisor(ATTRIBUTE_INSTANCE_LOCAL + i, 0);
+
+	InternalAttributes(window, old_attributes);
+	InternalSetInstance(NULL); // Arrays leave constant values undefined
+}
+
+
+inline void kaDrawDefaultInstanced(struct kaWindow* window, const struct kaInstances* instances, size_t count)
+{
+	if (window != NULL)
+		kaDrawInstanced(window, &window->default_index, instances, count);
 }
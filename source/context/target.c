@@ -0,0 +1,250 @@
+/*-----------------------------
+
+MIT License
+
+Copyright (c) 2020 Alexander Brandt
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-------------------------------
+
+ [context/target.c]
+ - Alexander Brandt 2020
+-----------------------------*/
+
+#include "private.h"
+
+#define DEPTH_COMPONENT24 0x81A6 // GLES3, desktop or 'GL_OES_depth24'
+#define READ_FRAMEBUFFER 0x8CA8  // GLES3, desktop or 'GL_EXT_framebuffer_blit'
+#define DRAW_FRAMEBUFFER 0x8CA9  // "
+#define RGBA8 0x8058             // "
+
+
+static inline GLuint sDrawFramebuffer(const struct kaRenderTarget* target)
+{
+	if (target == NULL)
+		return 0;
+
+	return (target->msaa_framebuffer != 0) ? target->msaa_framebuffer : target->framebuffer;
+}
+
+
+static void sFlush(struct kaWindow* window)
+{
+	// Everything deferred so far is for the current framebuffer, and
+	// the caller keeps drawing with what it had set
+	struct CallerState old;
+
+	InternalBatchFlush(window);
+	InternalSaveState(window, &old);
+
+	InternalCommandsFlush(window);
+	InternalQueueFlush(window);
+	InternalRestoreState(window, &old);
+}
+
+
+static int sCheck(GLuint framebuffer, struct jaStatus* st)
+{
+	// Synchronous, but unlike buffers incomplete framebuffers are
+	// common (formats, sizes), and creation is not a hot path
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		jaStatusSet(st, "kaRenderTargetInit", JA_STATUS_ERROR, "incomplete framebuffer");
+		return 1;
+	}
+
+	return 0;
+}
+
+
+int kaRenderTargetInit(struct kaWindow* window, size_t width, size_t height, bool depth, int samples,
+                       enum kaTextureFilter filter, enum kaTextureWrap wrap, struct kaRenderTarget* out,
+                       struct jaStatus* st)
+{
+	const struct jaImage blank = {.width = width, .height = height, .channels = 4, .format = JA_IMAGE_U8, .data = NULL};
+	const GLenum depth_format = (window->ext.depth24 == true) ? DEPTH_COMPONENT24 : GL_DEPTH_COMPONENT16;
+
+	jaStatusSet(st, "kaRenderTargetInit", JA_STATUS_SUCCESS, NULL);
+	memset(out, 0, sizeof(struct kaRenderTarget));
+
+	if (width == 0 || height == 0)
+	{
+		jaStatusSet(st, "kaRenderTargetInit", JA_STATUS_INVALID_ARGUMENT, "zero size");
+		return 1;
+	}
+
+	out->width = width;
+	out->height = height;
+	out->samples = (samples > window->ext.max_samples) ? window->ext.max_samples : (samples < 1) ? 1 : samples;
+
+	// Color texture, without mipmaps until resolved
+	if (kaTextureInitImage(window, &blank, filter, wrap, &out->texture, st) != 0)
+		return 1;
+
+	glGenFramebuffers(1, &out->framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, out->framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, out->texture.glptr, 0);
+
+	// Depth, that as multisampled one only if that is where draws go
+	if (depth == true && out->samples == 1)
+	{
+		glGenRenderbuffers(1, &out->depth);
+		glBindRenderbuffer(GL_RENDERBUFFER, out->depth);
+		glRenderbufferStorage(GL_RENDERBUFFER, depth_format, (GLsizei)width, (GLsizei)height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, out->depth);
+	}
+
+	if (sCheck(out->framebuffer, st) != 0)
+		goto return_failure;
+
+	// Multisampled framebuffer, resolved into the previous one
+	if (out->samples > 1)
+	{
+		glGenFramebuffers(1, &out->msaa_framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, out->msaa_framebuffer);
+
+		glGenRenderbuffers(1, &out->msaa_color);
+		glBindRenderbuffer(GL_RENDERBUFFER, out->msaa_color);
+		window->ext.RenderbufferStorageMultisample(GL_RENDERBUFFER, (GLsizei)out->samples, RGBA8, (GLsizei)width,
+		                                           (GLsizei)height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, out->msaa_color);
+
+		if (depth == true)
+		{
+			glGenRenderbuffers(1, &out->msaa_depth);
+			glBindRenderbuffer(GL_RENDERBUFFER, out->msaa_depth);
+			window->ext.RenderbufferStorageMultisample(GL_RENDERBUFFER, (GLsizei)out->samples, depth_format,
+			                                           (GLsizei)width, (GLsizei)height);
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, out->msaa_depth);
+		}
+
+		if (sCheck(out->msaa_framebuffer, st) != 0)
+			goto return_failure;
+	}
+
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, sDrawFramebuffer(window->current_target));
+	return 0;
+
+return_failure:
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, sDrawFramebuffer(window->current_target));
+	kaRenderTargetFree(window, out);
+	return 1;
+}
+
+
+void kaRenderTargetFree(struct kaWindow* window, struct kaRenderTarget* target)
+{
+	if (target == NULL)
+		return;
+
+	if (window != NULL && window->current_target == target)
+		kaRenderTargetUnbind(window);
+
+	if (target->msaa_framebuffer != 0)
+		glDeleteFramebuffers(1, &target->msaa_framebuffer);
+	if (target->msaa_color != 0)
+		glDeleteRenderbuffers(1, &target->msaa_color);
+	if (target->msaa_depth != 0)
+		glDeleteRenderbuffers(1, &target->msaa_depth);
+	if (target->framebuffer != 0)
+		glDeleteFramebuffers(1, &target->framebuffer);
+	if (target->depth != 0)
+		glDeleteRenderbuffers(1, &target->depth);
+
+	kaTextureFree(window, &target->texture);
+
+	target->msaa_framebuffer = 0;
+	target->msaa_color = 0;
+	target->msaa_depth = 0;
+	target->framebuffer = 0;
+	target->depth = 0;
+}
+
+
+void kaRenderTargetBind(struct kaWindow* window, const struct kaRenderTarget* target, bool clear)
+{
+	if (window == NULL || target == NULL)
+		return;
+
+	if (window->current_target != target)
+	{
+		sFlush(window);
+		glBindFramebuffer(GL_FRAMEBUFFER, sDrawFramebuffer(target));
+		glViewport(0, 0, (GLsizei)target->width, (GLsizei)target->height);
+
+		window->current_target = target;
+		window->stats.state_changes += 1;
+	}
+
+	if (clear == true)
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // With the clean color
+}
+
+
+void kaRenderTargetUnbind(struct kaWindow* window)
+{
+	int w = 0;
+	int h = 0;
+
+	if (window == NULL || window->current_target == NULL)
+		return;
+
+	sFlush(window);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	SDL_GetWindowSize(window->sdl_window, &w, &h);
+	glViewport(0, 0, w, h);
+
+	window->current_target = NULL;
+	window->stats.state_changes += 1;
+}
+
+
+void kaRenderTargetResolve(struct kaWindow* window, struct kaRenderTarget* target)
+{
+	if (window == NULL || target == NULL)
+		return;
+
+	if (window->current_target == target)
+		sFlush(window);
+
+	if (target->msaa_framebuffer != 0)
+	{
+		glBindFramebuffer(READ_FRAMEBUFFER, target->msaa_framebuffer);
+		glBindFramebuffer(DRAW_FRAMEBUFFER, target->framebuffer);
+		window->ext.BlitFramebuffer(0, 0, (GLint)target->width, (GLint)target->height, 0, 0, (GLint)target->width,
+		                            (GLint)target->height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_FRAMEBUFFER, sDrawFramebuffer(window->current_target));
+	}
+
+	// On the GPU, as pixels never were on the CPU
+	if (target->texture.filter != KA_FILTER_NONE)
+	{
+		GLuint old_bind = window->shadow.texture[window->shadow.active_unit];
+
+		InternalBindTexture(window, window->shadow.active_unit, target->texture.glptr);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		InternalBindTexture(window, window->shadow.active_unit, old_bind);
+	}
+}
@@ -35,6 +35,7 @@ SOFTWARE.
 #define DEFAULT_HEIGHT 480
 #define DEFAULT_FULLSCREEN 0
 #define DEFAULT_VSYNC 1
+#define DEFAULT_UPLOAD_BUDGET 4096 // In KiB
 
 
 static inline void sPrintWarning(struct jaStatus* st) // Only make noise if the cvar exists
@@ -57,6 +58,8 @@ int kaWindowCreate(const struct jaConfiguration* cfg, void (*init_callback)(stru
 	int cfg_height = DEFAULT_HEIGHT;
 	int cfg_fullscreen = DEFAULT_FULLSCREEN;
 	int cfg_vsync = DEFAULT_VSYNC;
+	int cfg_debug = 0;
+	int cfg_upload_budget = DEFAULT_UPLOAD_BUDGET;
 	const char* cfg_caption = "LibKansai";
 
 	jaStatusSet(st, "kaWindowCreate", JA_STATUS_SUCCESS, NULL);
@@ -76,6 +79,10 @@ int kaWindowCreate(const struct jaConfiguration* cfg, void (*init_callback)(stru
 		sPrintWarning(&cfg_st);
 		jaCvarGetValueString(jaCvarGet(cfg, "kansai.caption"), &cfg_caption, &cfg_st);
 		sPrintWarning(&cfg_st);
+		jaCvarGetValueInt(jaCvarGet(cfg, "kansai.debug"), &cfg_debug, &cfg_st);
+		sPrintWarning(&cfg_st);
+		jaCvarGetValueInt(jaCvarGet(cfg, "kansai.upload_budget"), &cfg_upload_budget, &cfg_st);
+		sPrintWarning(&cfg_st);
 	}
 
 	// Window
@@ -91,6 +98,14 @@ int kaWindowCreate(const struct jaConfiguration* cfg, void (*init_callback)(stru
 	window->mouse_callback = mouse_callback;
 	window->close_callback = close_callback;
 	window->user_data = user_data;
+	window->debug = (cfg_debug != 0) ? true : false;
+	window->loader.budget = (cfg_upload_budget > 0) ? (size_t)cfg_upload_budget * 1024 : 0;
+
+	if (InternalCommandsInit(window) != 0)
+	{
+		jaStatusSet(st, "kaWindowCreate", JA_STATUS_ERROR, "SDL_CreateMutex()");
+		goto return_failure;
+	}
 
 	// SDL2
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
@@ -129,13 +144,15 @@ int kaWindowCreate(const struct jaConfiguration* cfg, void (*init_callback)(stru
 		goto return_failure;
 	}
 
+	InternalLoadExtensions(window);
+
 	// OpenGL
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
+	kaSetDepthTest(window, true);
+	kaSetCullFace(window, true);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); // For when kaSetBlend()
 
-	glEnableVertexAttribArray(ATTRIBUTE_POSITION);
-	glEnableVertexAttribArray(ATTRIBUTE_COLOR);
-	glEnableVertexAttribArray(ATTRIBUTE_UV);
+	InternalAttributes(window, DEFAULT_ATTRIBUTES);
+	InternalSetInstance(NULL);
 
 	glPixelStorei(GL_PACK_ALIGNMENT, 1);
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
@@ -152,11 +169,12 @@ int kaWindowCreate(const struct jaConfiguration* cfg, void (*init_callback)(stru
 		const char* vertex_code =
 		    "#version 100\n"
 		    "attribute vec3 vertex_position; attribute vec4 vertex_color; attribute vec2 vertex_uv;"
-		    "uniform mat4 world; uniform mat4 camera; uniform mat4 local;"
+		    "attribute mat4 instance_local; attribute vec4 instance_color;"
+		    "uniform mat4 mvp; uniform vec3 dequantize_scale; uniform vec3 dequantize_offset;"
 		    "varying vec4 color; varying vec2 uv;"
 
-		    "void main() { color = vertex_color; uv = vertex_uv;"
-		    "gl_Position = world * camera * local * vec4(vertex_position, 1.0); }";
+		    "void main() { color = vertex_color * instance_color; uv = vertex_uv;"
+		    "gl_Position = mvp * instance_local * vec4(vertex_position * dequantize_scale + dequantize_offset, 1.0); }";
 
 		const char* fragment_code =
 		    "#version 100\n"
@@ -0,0 +1,298 @@
+/*-----------------------------
+
+MIT License
+
+Copyright (c) 2020 Alexander Brandt
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+-------------------------------
+
+ [context/workers.c]
+ - Alexander Brandt 2020
+-----------------------------*/
+
+#include "private.h"
+
+#define MAX_WORKERS 8
+
+
+struct Task
+{
+	void (*function)(void*);
+	void* data;
+	struct Task* next;
+};
+
+struct Pool
+{
+	SDL_Thread* thread[MAX_WORKERS];
+	int threads;
+
+	SDL_mutex* mutex;
+	SDL_cond* wake; // Workers, for jobs or tasks
+	SDL_cond* done; // Callers, for workers leaving them
+	bool quit;
+
+	void (*job)(void*); // Run by all available threads, NULL if none
+	void* job_data;
+	unsigned job_generation;
+	int job_active; // Workers inside
+
+	struct Task* tasks; // First in first out
+	struct Task* tasks_last;
+	void* running[MAX_WORKERS]; // Data of tasks, per worker
+};
+
+static SDL_SpinLock s_lock = 0; // For references
+static int s_references = 0;
+static struct Pool s_pool = {0}; // Shared by the whole process, as cores are
+
+
+static int sWorker(void* data)
+{
+	const int i = (int)(intptr_t)data;
+	unsigned generation = 0;
+	struct Task* task = NULL;
+
+	SDL_LockMutex(s_pool.mutex);
+
+	while (1)
+	{
+		while (s_pool.quit == false && s_pool.tasks == NULL &&
+		       (s_pool.job == NULL || s_pool.job_generation == generation))
+			SDL_CondWait(s_pool.wake, s_pool.mutex);
+
+		if (s_pool.quit == true)
+			break;
+
+		// Jobs first, their caller waits
+		if (s_pool.job != NULL && s_pool.job_generation != generation)
+		{
+			void (*job)(void*) = s_pool.job;
+			void* job_data = s_pool.job_data;
+
+			generation = s_pool.job_generation;
+			s_pool.job_active += 1;
+			SDL_UnlockMutex(s_pool.mutex);
+
+			job(job_data);
+
+			SDL_LockMutex(s_pool.mutex);
+			if ((s_pool.job_active -= 1) == 0)
+				SDL_CondBroadcast(s_pool.done);
+
+			continue;
+		}
+
+		task = s_pool.tasks;
+		s_pool.tasks = task->next;
+		s_pool.running[i] = task->data;
+		SDL_UnlockMutex(s_pool.mutex);
+
+		task->function(task->data);
+		free(task);
+
+		SDL_LockMutex(s_pool.mutex);
+		s_pool.running[i] = NULL;
+		SDL_CondBroadcast(s_pool.done);
+	}
+
+	SDL_UnlockMutex(s_pool.mutex);
+	return 0;
+}
+
+
+static void sStop()
+{
+	if (s_pool.mutex != NULL && s_pool.wake != NULL)
+	{
+		SDL_LockMutex(s_pool.mutex);
+		s_pool.quit = true;
+		SDL_CondBroadcast(s_pool.wake);
+		SDL_UnlockMutex(s_pool.mutex);
+
+		for (int i = 0; i < s_pool.threads; i++)
+			SDL_WaitThread(s_pool.thread[i], NULL);
+	}
+
+	for (struct Task* next = NULL; s_pool.tasks != NULL; s_pool.tasks = next)
+	{
+		next = s_pool.tasks->next;
+		free(s_pool.tasks);
+	}
+
+	if (s_pool.done != NULL)
+		SDL_DestroyCond(s_pool.done);
+	if (s_pool.wake != NULL)
+		SDL_DestroyCond(s_pool.wake);
+	if (s_pool.mutex != NULL)
+		SDL_DestroyMutex(s_pool.mutex);
+
+	memset(&s_pool, 0, sizeof(struct Pool));
+}
+
+
+int InternalWorkersAcquire(const char* function, struct jaStatus* st)
+{
+	// Started with the first reference, stopped with the last one
+	SDL_AtomicLock(&s_lock);
+
+	if (s_references == 0)
+	{
+		if ((s_pool.mutex = SDL_CreateMutex()) == NULL || (s_pool.wake = SDL_CreateCond()) == NULL ||
+		    (s_pool.done = SDL_CreateCond()) == NULL)
+		{
+			jaStatusSet(st, function, JA_STATUS_ERROR, "SDL_CreateMutex()");
+			goto return_failure;
+		}
+
+		// All processors but the calling one, at least one for tasks
+		for (int i = 0; i < SDL_GetCPUCount() - 1 && i < MAX_WORKERS; i++)
+		{
+			if ((s_pool.thread[i] = SDL_CreateThread(sWorker, "kaWorker", (void*)(intptr_t)i)) == NULL)
+				break; // Fine, with less workers
+
+			s_pool.threads += 1;
+		}
+
+		if (s_pool.threads == 0)
+		{
+			if ((s_pool.thread[0] = SDL_CreateThread(sWorker, "kaWorker", (void*)(intptr_t)0)) == NULL)
+			{
+				jaStatusSet(st, function, JA_STATUS_ERROR, "SDL_CreateThread()");
+				goto return_failure;
+			}
+
+			s_pool.threads = 1;
+		}
+	}
+
+	s_references += 1;
+	SDL_AtomicUnlock(&s_lock);
+	return 0;
+
+return_failure:
+	sStop();
+	SDL_AtomicUnlock(&s_lock);
+	return 1;
+}
+
+
+void InternalWorkersRelease()
+{
+	SDL_AtomicLock(&s_lock);
+
+	if (s_references > 0 && (s_references -= 1) == 0)
+		sStop();
+
+	SDL_AtomicUnlock(&s_lock);
+}
+
+
+void InternalWorkersFor(void (*function)(void*), void* data)
+{
+	// Function called by the calling thread and every available
+	// worker, all sharing what to do through 'data'. Returns once
+	// all of them finish
+	SDL_LockMutex(s_pool.mutex);
+
+	if (s_pool.job != NULL) // Another thread using them, alone then
+	{
+		SDL_UnlockMutex(s_pool.mutex);
+		function(data);
+		return;
+	}
+
+	s_pool.job = function;
+	s_pool.job_data = data;
+	s_pool.job_generation += 1;
+	SDL_CondBroadcast(s_pool.wake);
+	SDL_UnlockMutex(s_pool.mutex);
+
+	function(data);
+
+	// No one else joins from here
+	SDL_LockMutex(s_pool.mutex);
+	s_pool.job = NULL;
+
+	while (s_pool.job_active > 0)
+		SDL_CondWait(s_pool.done, s_pool.mutex);
+
+	SDL_UnlockMutex(s_pool.mutex);
+}
+
+
+int InternalWorkersPost(void (*function)(void*), void* data)
+{
+	struct Task* task = NULL;
+
+	if ((task = malloc(sizeof(struct Task))) == NULL)
+		return 1;
+
+	task->function = function;
+	task->data = data;
+	task->next = NULL;
+
+	SDL_LockMutex(s_pool.mutex);
+
+	if (s_pool.tasks == NULL)
+		s_pool.tasks = task;
+	else
+		s_pool.tasks_last->next = task;
+
+	s_pool.tasks_last = task;
+	SDL_CondSignal(s_pool.wake);
+	SDL_UnlockMutex(s_pool.mutex);
+	return 0;
+}
+
+
+void InternalWorkersCancel(void* data)
+{
+	// Tasks with 'data', those queued never run, running ones are waited
+	struct Task** task = NULL;
+	struct Task* last = NULL;
+
+	SDL_LockMutex(s_pool.mutex);
+
+	for (task = &s_pool.tasks; *task != NULL;)
+	{
+		if ((*task)->data == data)
+		{
+			struct Task* temp = *task;
+			*task = temp->next;
+			free(temp);
+			continue;
+		}
+
+		last = *task;
+		task = &(*task)->next;
+	}
+
+	s_pool.tasks_last = last;
+
+	for (int i = 0; i < s_pool.threads; i++)
+	{
+		while (s_pool.running[i] == data)
+			SDL_CondWait(s_pool.done, s_pool.mutex);
+	}
+
+	SDL_UnlockMutex(s_pool.mutex);
+}